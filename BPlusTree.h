@@ -2,15 +2,133 @@
 #define BPlusTree_H
 
 #include <iostream>
+#include "BPlusTreeAggregate.h"
+#include "BPlusTreeKey.h"
+#include "BPlusTreeStats.h"
+#include "NodeArena.h"
+#include "NodeLatch.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// -DBPLUSTREE_COUNTERS compiles in the counters behind BPlusTree::counters().
+#ifdef BPLUSTREE_COUNTERS
+#define BPLUSTREE_COUNT(counter, n) this->hot_counters.counter.fetch_add((n), std::memory_order_relaxed)
+#else
+#define BPLUSTREE_COUNT(counter, n) ((void)0)
+#endif
 
+// Keys that are 32-bit integers themselves can be compared four at a time.
 template <typename T>
-struct Node {
+constexpr bool bptree_simd_key() {
+#if defined(__SSE2__)
+    return std::is_integral<T>::value && sizeof(T) == 4;
+#else
+    return false;
+#endif
+}
+
+#if defined(__SSE2__)
+// Number of the first len (<= 8) keys that are less than key (upper: not greater than key).
+// Reads 8 slots, so the array must have room for them; slots past len are masked out.
+template <typename T, bool upper>
+int bptree_simd_rank(const T* arr, int len, T key) {
+    const __m128i bias = _mm_set1_epi32(std::is_signed<T>::value ? 0 : INT32_MIN); // unsigned -> signed order
+    const __m128i k = _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(key)), bias);
+    const __m128i limit = _mm_set1_epi32(len);
+    __m128i count = _mm_setzero_si128();
+    for(int i=0; i<8; i+=4){
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(arr + i)), bias);
+        __m128i valid = _mm_cmplt_epi32(_mm_set_epi32(i+3, i+2, i+1, i), limit);
+        __m128i hit = upper ? _mm_andnot_si128(_mm_cmpgt_epi32(v, k), valid) : _mm_and_si128(_mm_cmplt_epi32(v, k), valid);
+        count = _mm_sub_epi32(count, hit); // hit lanes are -1
+    }
+    count = _mm_add_epi32(count, _mm_shuffle_epi32(count, 0x4e));
+    count = _mm_add_epi32(count, _mm_shuffle_epi32(count, 0xb1));
+    return _mm_cvtsi128_si32(count);
+}
+
+// Bit j of the result is set when lo <= column[j] <= hi, for the 4 values from column.
+template <typename C>
+int bptree_simd_select(const C* column, C lo, C hi) {
+    if constexpr (std::is_floating_point<C>::value) {
+        __m128 v = _mm_loadu_ps(column);
+        return _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v, _mm_set1_ps(lo)), _mm_cmple_ps(v, _mm_set1_ps(hi))));
+    }
+    else {
+        const __m128i bias = _mm_set1_epi32(std::is_signed<C>::value ? 0 : INT32_MIN); // unsigned -> signed order
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(column)), bias);
+        __m128i out = _mm_or_si128(_mm_cmplt_epi32(v, _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(lo)), bias)),
+                                   _mm_cmpgt_epi32(v, _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(hi)), bias)));
+        return ~_mm_movemask_ps(_mm_castsi128_ps(out)) & 0xf;
+    }
+}
+#endif
+
+template <typename T, std::size_t Fanout, typename Aggregate>
+struct Node;
+
+// Leaf column (see BPlusTreeKey::column) of a node with a compile-time fanout.
+template <typename C, std::size_t Slots>
+struct NodeColumnStorage {
+    C column_buf[Slots];
+};
+
+template <std::size_t Slots>
+struct NodeColumnStorage<void, Slots> {
+};
+
+// With a compile-time fanout the item and children arrays live inside the node.
+template <typename T, std::size_t Fanout, typename Aggregate>
+struct NodeStorage : NodeColumnStorage<typename bptree_column<T>::type, Fanout-1> {
+    T item_buf[Fanout-1 + (bptree_simd_key<T>() ? 8 : 0)] {}; // padded for the 8-slot SIMD tail
+    Node<T, Fanout, Aggregate>* children_buf[Fanout];
+    unsigned char dead_buf[Fanout-1];
+};
+
+template <typename T, typename Aggregate>
+struct NodeStorage<T, 0, Aggregate> {
+};
+
+// Item count and Aggregate summary of the subtree, kept only by augmented trees.
+template <typename Aggregate>
+struct NodeSummary {
+    std::size_t count = 0;
+    typename Aggregate::value_type summary = Aggregate::identity();
+};
+
+template <>
+struct NodeSummary<void> {
+};
+
+// Nodes are placed in blocks of block_size(degree) bytes. Without a compile-time fanout the
+// item, children, dead and column arrays follow the header inside the same block.
+template <typename T, std::size_t Fanout = 0, typename Aggregate = void>
+struct Node : NodeStorage<T, Fanout, Aggregate>, NodeSummary<Aggregate> {
+    using column_type = typename bptree_column<T>::type; // void if T has no column
+    static constexpr bool columnar = !std::is_void<column_type>::value;
+
     bool is_leaf;
     std::size_t degree; // maximum number of children
     std::size_t size; // current number of item
     T* item;
-    Node<T>** children;
-    Node<T>* parent;
+    Node<T, Fanout, Aggregate>** children;
+    Node<T, Fanout, Aggregate>* parent;
+    unsigned char* dead; // tombstone flags of a leaf's items, see BPlusTree::tombstone
+    std::size_t tombstones; // how many are set
+    column_type* column; // BPlusTreeKey<T>::column of a leaf's items, if T has one
+    NodeLatch latch; // only used when the tree is in thread-safe mode
 
 public:
     Node(std::size_t _degree) {// Constructor
@@ -18,224 +136,547 @@ public:
         this->degree = _degree;
         this->size = 0;
 
-        T* _item = new T[degree-1];
-        for(int i=0; i<degree-1; i++){
-            _item[i] = T();
+        if constexpr (Fanout != 0) {
+            this->item = this->item_buf;
+            this->children = this->children_buf;
+            this->dead = this->dead_buf;
+            if constexpr (columnar) {
+                this->column = this->column_buf;
+            }
+            else {
+                this->column = nullptr;
+            }
+        }
+        else {
+            char* block = reinterpret_cast<char*>(this);
+            this->item = reinterpret_cast<T*>(block + items_offset());
+            for(int i=0; i<degree-1; i++){
+                new (this->item + i) T();
+            }
+            this->children = reinterpret_cast<Node<T, Fanout, Aggregate>**>(block + children_offset(degree));
+            this->dead = reinterpret_cast<unsigned char*>(block + dead_offset(degree));
+            this->column = columnar ? reinterpret_cast<column_type*>(block + column_offset(degree)) : nullptr;
         }
-        this->item = _item;
 
-        Node<T>** _children = new Node<T>*[degree];
         for(int i=0; i<degree; i++){
-            _children[i] = nullptr;
+            this->children[i] = nullptr;
         }
-        this->children = _children;
+        std::fill(this->dead, this->dead + degree - 1, 0);
+        this->tombstones = 0;
 
         this->parent = nullptr;
 
     }
+
+    ~Node() {
+        if constexpr (Fanout == 0) {
+            for(int i=0; i<degree-1; i++){
+                this->item[i].~T();
+            }
+        }
+    }
+
+    static std::size_t items_offset() {
+        return (sizeof(Node<T, Fanout, Aggregate>) + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+    static std::size_t children_offset(std::size_t degree) {
+        const std::size_t align = alignof(Node<T, Fanout, Aggregate>*);
+        return (items_offset() + (degree-1) * sizeof(T) + align - 1) / align * align;
+    }
+    static std::size_t dead_offset(std::size_t degree) {
+        return children_offset(degree) + degree * sizeof(Node<T, Fanout, Aggregate>*);
+    }
+    static std::size_t column_offset(std::size_t degree) {
+        if constexpr (columnar) {
+            const std::size_t align = alignof(column_type);
+            return (dead_offset(degree) + degree - 1 + align - 1) / align * align;
+        }
+        else {
+            return dead_offset(degree) + degree - 1;
+        }
+    }
+    static std::size_t block_size(std::size_t degree) {
+        if constexpr (Fanout != 0) {
+            return sizeof(Node<T, Fanout, Aggregate>);
+        }
+        else if constexpr (columnar) {
+            return column_offset(degree) + (degree - 1) * sizeof(column_type);
+        }
+        else {
+            return dead_offset(degree) + degree - 1;
+        }
+    }
 };
 
-template <typename T>
+// With an Aggregate (see BPlusTreeAggregate.h) every node also keeps the count and summary of
+// its subtree, which gives rank, select, range_count and range_aggregate in O(log n).
+template <typename T, std::size_t Fanout = 0, typename Aggregate = void>
 class BPlusTree {
-    Node<T>* root;
+    static constexpr bool augmented = !std::is_void<Aggregate>::value;
+    using column_type = typename bptree_column<T>::type;
+    static constexpr bool columnar = !std::is_void<column_type>::value;
+
+    Node<T, Fanout, Aggregate>* root;
     std::size_t degree;
+    NodeArena arena; // every node of the tree lives here
+
+    // Thread-safe mode is pessimistic latch coupling, not optimistic (version-validated) reads:
+    // readers and inserts share tree_latch and couple node latches top-down (and leaf to next
+    // leaf), inserts latching exclusively only the nodes a split can reach. A reader takes every
+    // latch on its path, so it waits for a writer holding one of them, and a waiting writer keeps
+    // new readers out of its node (see NodeLatch). remove, tombstone, erase_range, bulk_load,
+    // insert_batch, clear, compact and compact_step take tree_latch exclusively and stop every
+    // other thread while they run. root_latch guards the root pointer.
+    bool thread_safe;
+    NodeLatch tree_latch;
+    NodeLatch root_latch;
+    NodeLatch arena_latch;
+    std::atomic<std::size_t> tombstone_count; // inserts purge leaves under node latches only
+
+    // Where compact_step resumes: a leaf, valid while no node has been freed since (frees is
+    // still compact_frees), else found again from its first item.
+    Node<T, Fanout, Aggregate>* compact_next = nullptr;
+    T compact_key{};
+    std::size_t frees = 0;
+    std::size_t compact_frees = 0;
+
+#ifdef BPLUSTREE_COUNTERS
+    struct {
+        std::atomic<std::uint64_t> inserts{0}, removes{0}, lookups{0}, comparisons{0};
+        std::atomic<std::uint64_t> node_visits{0}, splits{0}, merges{0}, borrows{0};
+    } hot_counters;
+#endif
 
 public:
-    BPlusTree(std::size_t _degree) {// Constructor
+    using column_range = BPlusTreeColumnRange<column_type>;
+
+    // Forward iterator over the items in key order. It walks the leaf chain, so advancing
+    // is O(1) and nothing is copied; it stays valid until the tree is modified.
+    class iterator {
+        Node<T, Fanout, Aggregate>* node;
+        int index;
+
+        void skip_empty(){ // and tombstoned items
+            while(node != nullptr){
+                if(index >= node->size){
+                    node = node->children[node->size]; //next leaf
+                    index = 0;
+                }
+                else if(node->tombstones != 0 && node->dead[index]){
+                    index++;
+                }
+                else{
+                    break;
+                }
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator(Node<T, Fanout, Aggregate>* _node = nullptr, int _index = 0) : node(_node), index(_index) {
+            skip_empty();
+        }
+
+        T& operator*() const { return node->item[index]; }
+        T* operator->() const { return &node->item[index]; }
+
+        iterator& operator++(){
+            index++;
+            skip_empty();
+            return *this;
+        }
+        iterator operator++(int){
+            iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        bool operator==(const iterator& other) const { return node == other.node && index == other.index; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+    };
+
+    BPlusTree(std::size_t _degree = Fanout, bool _thread_safe = false)
+        : arena(Node<T, Fanout, Aggregate>::block_size(Fanout != 0 ? Fanout : _degree)) {// Constructor
         this->root = nullptr;
-        this->degree = _degree;
+        this->degree = Fanout != 0 ? Fanout : _degree; // a compile-time fanout fixes the degree
+        this->thread_safe = _thread_safe;
+        this->tombstone_count = 0;
     }
     ~BPlusTree() { // Destructor
-        clear(this->root);
+        release_all();
     }
 
-    Node<T>* getroot(){
-        return this->root;
+    // Switch thread-safe mode on or off. Call it while no other thread uses the tree. Lookups
+    // and scans then run side by side, and alongside single inserts; every other write runs alone.
+    // Iterators never take latches: with concurrent writers use search, range_for_each,
+    // range_search and for_each, which do.
+    void set_thread_safe(bool _thread_safe){
+        this->thread_safe = _thread_safe;
     }
 
-    Node<T>* BPlusTreeSearch(Node<T>* node, T key){
-        if(node == nullptr) { // if root is null, return nullptr
-            return nullptr;
+    Node<T, Fanout, Aggregate>* new_node(){
+        if(this->thread_safe){
+            this->arena_latch.lock();
         }
-        else{
-            Node<T>* cursor = node; // cursor finding key
+        void* block = this->arena.allocate();
+        if(this->thread_safe){
+            this->arena_latch.unlock();
+        }
+        return new (block) Node<T, Fanout, Aggregate>(this->degree);
+    }
+    void free_node(Node<T, Fanout, Aggregate>* node){
+        node->~Node();
+        this->arena.deallocate(node); // only remove and clear free nodes, and they run alone
+        this->frees++;
+    }
 
-            while(!cursor->is_leaf){ // until cusor pointer arrive leaf
-                for(int i=0; i<cursor->size; i++){ //in this index node, find what we want key
-                    if(key < cursor->item[i]){ //find some range, and let find their child also.
-                        cursor = cursor->children[i];
-                        break;
-                    }
-                    if(i == (cursor->size)-1){
-                        cursor = cursor->children[i+1];
-                        break;
-                    }
+    // Recompute the count and summary of node from its items or children.
+    void refresh(Node<T, Fanout, Aggregate>* node){
+        if constexpr (augmented) {
+            auto summary = Aggregate::identity();
+            if(node->is_leaf){
+                node->count = node->size;
+                for(int i=0; i<node->size; i++){
+                    summary = Aggregate::combine(summary, Aggregate::of(node->item[i]));
                 }
             }
-
-            //search for the key if it exists in leaf node.
-            for(int i=0; i<cursor->size; i++){
-                if(cursor->item[i] == key){
-                    return cursor;
+            else{
+                node->count = 0;
+                for(int i=0; i<=node->size; i++){
+                    node->count += node->children[i]->count;
+                    summary = Aggregate::combine(summary, node->children[i]->summary);
                 }
             }
-
-            return nullptr;
+            node->summary = summary;
+        }
+    }
+    void refresh_path(Node<T, Fanout, Aggregate>* node){
+        if constexpr (augmented) {
+            for(; node != nullptr; node = node->parent){
+                refresh(node);
+            }
+        }
+    }
+    // Fold an item about to be inserted under node into node and its ancestors.
+    void augment_path(Node<T, Fanout, Aggregate>* node, const T& data){
+        if constexpr (augmented) {
+            auto summary = Aggregate::of(data);
+            for(; node != nullptr; node = node->parent){
+                node->count++;
+                node->summary = Aggregate::combine(node->summary, summary);
+            }
         }
     }
 
+    // Recompute the column of leaf from its items.
+    void refresh_column(Node<T, Fanout, Aggregate>* leaf){
+        if constexpr (columnar) {
+            for(int i=0; i<leaf->size; i++){
+                leaf->column[i] = BPlusTreeKey<T>::column(leaf->item[i]);
+            }
+        }
+    }
+    // Column values [first, last) of from go to dest on of to, as the items they belong to move.
+    // The ranges may overlap.
+    void move_column(Node<T, Fanout, Aggregate>* from, int first, int last, Node<T, Fanout, Aggregate>* to, int dest){
+        if constexpr (columnar) {
+            if(last > first){
+                std::memmove(to->column + dest, from->column + first, (last - first) * sizeof(column_type));
+            }
+        }
+    }
 
+    void read_lock(){
+        if(this->thread_safe){
+            this->tree_latch.lock_shared();
+        }
+    }
+    void read_unlock(){
+        if(this->thread_safe){
+            this->tree_latch.unlock_shared();
+        }
+    }
+    void write_lock(){
+        if(this->thread_safe){
+            this->tree_latch.lock();
+        }
+    }
+    void write_unlock(){
+        if(this->thread_safe){
+            this->tree_latch.unlock();
+        }
+    }
 
-    
-    Node<T>* BPlusTreeRangeSearch(Node<T>* node, T key){
-        if(node == nullptr) { // if root is null, return nullptr
+    // Leaf where a scan from key starts (the leftmost leaf when key is null). In thread-safe
+    // mode the descent couples shared latches and the leaf is returned latched.
+    Node<T, Fanout, Aggregate>* find_leaf(const T* key){
+        if(this->thread_safe){
+            this->root_latch.lock_shared();
+        }
+        Node<T, Fanout, Aggregate>* cursor = this->root;
+        if(cursor != nullptr && this->thread_safe){
+            cursor->latch.lock_shared();
+        }
+        if(this->thread_safe){
+            this->root_latch.unlock_shared();
+        }
+        if(cursor == nullptr){
             return nullptr;
         }
-        else{
-            Node<T>* cursor = node; // cursor finding key
+        while(!cursor->is_leaf){
+            Node<T, Fanout, Aggregate>* child = cursor->children[key ? node_rank<false>(cursor, *key) : 0];
+            if(this->thread_safe){
+                child->latch.lock_shared();
+                cursor->latch.unlock_shared();
+            }
+            cursor = child;
+        }
+        return cursor;
+    }
 
-            while(!cursor->is_leaf){ // until cusor pointer arrive leaf
-                for(int i=0; i<cursor->size; i++){ //in this index node, find what we want key
-                    if(key < cursor->item[i]){ //find some range, and let find their child also.
-                        cursor = cursor->children[i];
-                        break;
-                    }
-                    if(i == (cursor->size)-1){
-                        cursor = cursor->children[i+1];
-                        break;
-                    }
+    // Call f on the items of leaf from index on, then on the following leaves, until f returns
+    // false.
+    template<typename Func>
+    void walk_leaves(Node<T, Fanout, Aggregate>* leaf, int index, Func f){
+        walk_leaf_chain(leaf, index, [&](Node<T, Fanout, Aggregate>* cursor, int from){
+            for(int i=from; i<cursor->size; i++){
+                if(cursor->tombstones != 0 && cursor->dead[i]){
+                    continue;
+                }
+                if(!f(cursor->item[i])){
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+    // Call visit(leaf, index), then visit(next, 0) on each following leaf, until it returns
+    // false. In thread-safe mode the next leaf is latched before the current one is let go.
+    template<typename Visit>
+    void walk_leaf_chain(Node<T, Fanout, Aggregate>* leaf, int index, Visit visit){
+        while(leaf != nullptr){
+            if(!visit(leaf, index)){
+                if(this->thread_safe){
+                    leaf->latch.unlock_shared();
                 }
+                return;
+            }
+            Node<T, Fanout, Aggregate>* next = leaf->children[leaf->size];
+            if(next != nullptr){
+                BPLUSTREE_COUNT(node_visits, 1);
+            }
+            if(this->thread_safe){
+                if(next != nullptr){
+                    next->latch.lock_shared();
+                }
+                leaf->latch.unlock_shared();
             }
-            return cursor;
+            leaf = next;
+            index = 0;
         }
     }
 
+    Node<T, Fanout, Aggregate>* getroot(){
+        return this->root;
+    }
 
+    // Number of items in arr[0, len) that are less than key (upper: not greater than key).
+    template<bool upper>
+    int array_rank(const T* arr, int len, const T& key){
+        if(len == 0){
+            return 0;
+        }
+        const T* base = arr;
+        while(len > 1){ // lower/upper bound binary search, the step is a conditional move
+            BPLUSTREE_COUNT(comparisons, 1);
+            int half = len / 2;
+            base = (upper ? !(key < base[half]) : (base[half] < key)) ? base + half : base;
+            len -= half;
+        }
+        BPLUSTREE_COUNT(comparisons, 1);
+        return (base - arr) + (upper ? !(key < *base) : (*base < key));
+    }
 
-    int range_search(T start, T end, T* result_data, int arr_length) {
-        int index=0;
-
-        Node<T>* start_node = BPlusTreeRangeSearch(this->root,start);
-        Node<T>* cursor = start_node;
-        T temp= cursor->item[0];
-
-        while(temp<=end){
-            if(cursor == nullptr){
-                break;
+    // Same as array_rank over the items of a node. With a compile-time fanout and a key that
+    // normalizes to an integer the search runs on normalized keys; when the items themselves
+    // are 32-bit integers the last 8 candidates are counted with SIMD compares.
+    template<bool upper>
+    int node_rank(const Node<T, Fanout, Aggregate>* node, const T& key){
+        BPLUSTREE_COUNT(node_visits, 1);
+        if constexpr (Fanout != 0 && BPlusTreeKey<T>::normalized) {
+            using Key = BPlusTreeKey<T>;
+            auto k = Key::normalize(key);
+            const T* base = node->item;
+            int len = node->size;
+            if(len == 0){
+                return 0;
             }
-            for(int i=0; i< cursor->size;i++){
-                temp = cursor->item[i];
-                if((temp >= start)&&(temp <= end)){
-                    result_data[index] = temp;
-                    index++;
+#if defined(__SSE2__)
+            if constexpr (bptree_simd_key<T>()) {
+                while(len > 8){
+                    BPLUSTREE_COUNT(comparisons, 1);
+                    int half = len / 2;
+                    base = (upper ? !(k < Key::normalize(base[half])) : (Key::normalize(base[half]) < k)) ? base + half : base;
+                    len -= half;
+                }
+                BPLUSTREE_COUNT(comparisons, len);
+                return (base - node->item) + bptree_simd_rank<T, upper>(base, len, key);
+            }
+#endif
+            while(len > 1){
+                BPLUSTREE_COUNT(comparisons, 1);
+                int half = len / 2;
+                base = (upper ? !(k < Key::normalize(base[half])) : (Key::normalize(base[half]) < k)) ? base + half : base;
+                len -= half;
+            }
+            BPLUSTREE_COUNT(comparisons, 1);
+            return (base - node->item) + (upper ? !(k < Key::normalize(*base)) : (Key::normalize(*base) < k));
+        }
+        else {
+            return array_rank<upper>(node->item, node->size, key);
+        }
+    }
+
+    // Leaf holding the first live item equal to key, and its position in index.
+    Node<T, Fanout, Aggregate>* BPlusTreeSearch(Node<T, Fanout, Aggregate>* node, const T& key, int& index){
+        //leftmost leaf that can hold key; equal keys may continue on the next leaves
+        Node<T, Fanout, Aggregate>* cursor = BPlusTreeLowerSearch(node, key);
+
+        //search for the key if it exists in leaf node.
+        while(cursor != nullptr){
+            for(int i=node_rank<false>(cursor, key); i<cursor->size; i++){
+                BPLUSTREE_COUNT(comparisons, 1);
+                if(key < cursor->item[i]){
+                    return nullptr;
+                }
+                if(cursor->item[i] == key && !(cursor->tombstones != 0 && cursor->dead[i])){
+                    index = i;
+                    return cursor;
                 }
             }
             cursor = cursor->children[cursor->size];
         }
-        return index;
+        return nullptr;
     }
-    bool search(T data) {  // Return true if the item exists. Return false if it does not.
-        return BPlusTreeSearch(this->root, data) != nullptr;
+
+    // Leaf where key would be inserted (after any equal items).
+    Node<T, Fanout, Aggregate>* BPlusTreeRangeSearch(Node<T, Fanout, Aggregate>* node, const T& key){
+        if(node == nullptr) { // if root is null, return nullptr
+            return nullptr;
+        }
+        Node<T, Fanout, Aggregate>* cursor = node; // cursor finding key
+        while(!cursor->is_leaf){ // until cusor pointer arrive leaf
+            cursor = cursor->children[node_rank<true>(cursor, key)];
+        }
+        return cursor;
     }
 
-    int find_index(T* arr, T data, int len){
-        int index = 0;
-        for(int i=0; i<len; i++){
-            if(data < arr[i]){
-                index = i;
-                break;
-            }
-            if(i==len-1){
-                index = len;
-                break;
-            }
+    // Leftmost leaf that can hold an item not less than key.
+    Node<T, Fanout, Aggregate>* BPlusTreeLowerSearch(Node<T, Fanout, Aggregate>* node, const T& key){
+        if(node == nullptr) { // if root is null, return nullptr
+            return nullptr;
         }
-        return index;
+        Node<T, Fanout, Aggregate>* cursor = node; // cursor finding key
+        while(!cursor->is_leaf){ // until cusor pointer arrive leaf
+            cursor = cursor->children[node_rank<false>(cursor, key)];
+        }
+        return cursor;
     }
-    T* item_insert(T* arr, T data, int len){
-        int index = 0;
-        for(int i=0; i<len; i++){
-            if(data < arr[i]){
-                index = i;
-                break;
-            }
-            if(i==len-1){
-                index = len;
-                break;
+
+    // Copy the items between start and end (same bounds as range_for_each) into result_data.
+    // Stops after arr_length items; range_for_each has no such limit.
+    int range_search(const T& start, const T& end, T* result_data, int arr_length) {
+        int index=0;
+        range_for_each(start, end, [&](T& item){
+            if(index == arr_length){
+                return false;
             }
+            result_data[index++] = item;
+            return true;
+        });
+        return index;
+    }
+    bool search(const T& data) {  // Return true if the item exists. Return false if it does not.
+        bool found = false;
+        BPLUSTREE_COUNT(lookups, 1);
+        read_lock();
+        Node<T, Fanout, Aggregate>* leaf = find_leaf(&data);
+        if(leaf != nullptr){
+            walk_leaves(leaf, node_rank<false>(leaf, data), [&](T& item){
+                BPLUSTREE_COUNT(comparisons, 1);
+                if(data < item){
+                    return false;
+                }
+                found = item == data;
+                return !found;
+            });
         }
+        read_unlock();
+        return found;
+    }
 
-        for(int i = len; i > index; i--){
-            arr[i] = arr[i-1];
-        }
+    int find_index(const T* arr, const T& data, int len){
+        return array_rank<true>(arr, len, data);
+    }
+    // Insert data (copied or moved, as passed) after the items not greater than it.
+    template<typename U>
+    T* item_insert(T* arr, U&& data, int len){
+        int index = array_rank<true>(arr, len, data);
+
+        std::move_backward(arr + index, arr + len, arr + len + 1);
 
-        arr[index] = data;
+        arr[index] = std::forward<U>(data);
 
         return arr;
     }
-    Node<T>** child_insert(Node<T>** child_arr, Node<T>*child,int len,int index){
+    Node<T, Fanout, Aggregate>** child_insert(Node<T, Fanout, Aggregate>** child_arr, Node<T, Fanout, Aggregate>*child,int len,int index){
         for(int i= len; i > index; i--){
             child_arr[i] = child_arr[i - 1];
         }
         child_arr[index] = child;
         return child_arr;
     }
-    Node<T>* child_item_insert(Node<T>* node, T data, Node<T>* child){
-        int item_index=0;
-        int child_index=0;
-        for(int i=0; i< node->size; i++){
-            if(data < node->item[i]){
-                item_index = i;
-                child_index = i+1;
-                break;
-            }
-            if(i==node->size-1){
-                item_index = node->size;
-                child_index = node->size+1;
-                break;
-            }
-        }
-        for(int i = node->size;i > item_index; i--){
-            node->item[i] = node->item[i-1];
-        }
+    Node<T, Fanout, Aggregate>* child_item_insert(Node<T, Fanout, Aggregate>* node, T&& data, Node<T, Fanout, Aggregate>* child, int item_index){
+        int child_index = item_index + 1;
+        std::move_backward(node->item + item_index, node->item + node->size, node->item + node->size + 1);
         for(int i=node->size+1;i>child_index;i--){
             node->children[i] = node->children[i-1];
         }
 
-        node->item[item_index] = data;
+        node->item[item_index] = std::move(data);
         node->children[child_index] = child;
 
         return node;
     }
-    void InsertPar(Node<T>* par,Node<T>* child, T data){
+    void InsertPar(Node<T, Fanout, Aggregate>* par,Node<T, Fanout, Aggregate>* left,Node<T, Fanout, Aggregate>* child, T&& data){
+        //the new child goes right after the node it was split from. Its position can't be
+        //found from data alone: with duplicate keys data may equal several separators
+        int index = 0;
+        while(par->children[index] != left){
+            index++;
+        }
+
         //overflow check
-        Node<T>* cursor = par;
+        Node<T, Fanout, Aggregate>* cursor = par;
         if(cursor->size < this->degree-1){//not overflow, just insert in the correct position
             //insert item, child, and reallocate
-            cursor = child_item_insert(cursor,data,child);
+            cursor = child_item_insert(cursor,std::move(data),child,index);
             cursor->size++;
         }
         else{//overflow
+            BPLUSTREE_COUNT(splits, 1);
             //make new node
-            auto* Newnode = new Node<T>(this->degree);
+            auto* Newnode = new_node();
             Newnode->parent = cursor->parent;
 
-            //copy item
-            T* item_copy = new T[cursor->size+1];
-            for(int i=0; i<cursor->size; i++){
-                item_copy[i] = cursor->item[i];
-            }
-            item_copy = item_insert(item_copy,data,cursor->size);
-
-            auto** child_copy = new Node<T>*[cursor->size+2];
-            for(int i=0; i<cursor->size+1;i++){
-                child_copy[i] = cursor->children[i];
-            }
-            child_copy[cursor->size+1] = nullptr;
-            child_copy = child_insert(child_copy,child,cursor->size+1,find_index(item_copy,data,cursor->size+1));
-
-            //split nodes
-            cursor->size = (this->degree)/2;
+            //split in place: the full node plus the new item/child form degree items and
+            //degree+1 children; the upper part moves to Newnode, the middle item goes up
+            int left_size = (this->degree)/2;
             if((this->degree) % 2 == 0){
                 Newnode->size = (this->degree) / 2 -1;
             }
@@ -243,544 +684,1384 @@ public:
                 Newnode->size = (this->degree) / 2;
             }
 
-            for(int i=0; i<cursor->size;i++){
-                cursor->item[i] = item_copy[i];
-                cursor->children[i] = child_copy[i];
+            for(int j=left_size+1; j<this->degree; j++){
+                Newnode->item[j-left_size-1] = std::move(j < index ? cursor->item[j] : (j == index ? data : cursor->item[j-1]));
             }
-            cursor->children[cursor->size] = child_copy[cursor->size];
-            //todo 안지워짐. 뒤에것.
-
-            for(int i=0; i < Newnode->size; i++){
-                Newnode->item[i] = item_copy[cursor->size + i +1];
-                Newnode->children[i] = child_copy[cursor->size+i+1];
-                Newnode->children[i]->parent=Newnode;
+            for(int c=left_size+1; c<=this->degree; c++){
+                Node<T, Fanout, Aggregate>* moved = c <= index ? cursor->children[c] : (c == index+1 ? child : cursor->children[c-1]);
+                Newnode->children[c-left_size-1] = moved;
+                moved->parent = Newnode;
             }
-            Newnode->children[Newnode->size] = child_copy[cursor->size+Newnode->size+1];
-            Newnode->children[Newnode->size]->parent=Newnode;
-
-            T paritem = item_copy[this->degree/2];
+            T paritem = std::move(left_size < index ? cursor->item[left_size] : (left_size == index ? data : cursor->item[left_size-1]));
 
-            delete[] item_copy;
-            delete[] child_copy;
+            if(index < left_size){ //data and child stay on the left
+                std::move_backward(cursor->item + index, cursor->item + left_size - 1, cursor->item + left_size);
+                cursor->item[index] = std::move(data);
+                for(int i=left_size; i>index+1; i--){
+                    cursor->children[i] = cursor->children[i-1];
+                }
+                cursor->children[index+1] = child;
+            }
+            cursor->size = left_size;
+            for(int i=left_size+1; i<this->degree; i++){
+                cursor->children[i] = nullptr;
+            }
+            refresh(cursor);
+            refresh(Newnode);
 
             //parent check
             if(cursor->parent == nullptr){//if there are no parent node(root case)
-                auto* Newparent = new Node<T>(this->degree);
+                auto* Newparent = new_node();
                 cursor->parent = Newparent;
                 Newnode->parent = Newparent;
 
-                Newparent->item[0] = paritem;
+                Newparent->item[0] = std::move(paritem);
                 Newparent->size++;
 
                 Newparent->children[0] = cursor;
                 Newparent->children[1] = Newnode;
+                refresh(Newparent);
 
                 this->root = Newparent;
 
                 //delete Newparent;
             }
             else{//if there already have parent node
-                InsertPar(cursor->parent, Newnode, paritem);
+                InsertPar(cursor->parent, cursor, Newnode, std::move(paritem));
             }
         }
     }
-    void insert(T data) {
+    void insert(const T& data) {
+        insert(T(data)); // the only copy; everything below moves
+    }
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        insert(T(std::forward<Args>(args)...));
+    }
+    void insert(T&& data) {
+        BPLUSTREE_COUNT(inserts, 1);
+        if(!this->thread_safe){
+            insert_unlatched(std::move(data));
+        }
+        else if constexpr (augmented) { // every insert changes the root's summary: no crabbing
+            write_lock();
+            insert_unlatched(std::move(data));
+            write_unlock();
+        }
+        else {
+            insert_latched(std::move(data));
+        }
+    }
+    void insert_unlatched(T&& data) {
         if(this->root == nullptr){ //if the tree is empty
-            this->root = new Node<T>(this->degree);
+            this->root = new_node();
             this->root->is_leaf = true;
-            this->root->item[0] = data;
+            this->root->item[0] = std::move(data);
             this->root->size = 1; //
+            refresh(this->root);
+            refresh_column(this->root);
         }
         else{ //if the tree has at least one node
-            Node<T>* cursor = this->root;
-
             //move to leaf node
-            cursor = BPlusTreeRangeSearch(cursor, data);
+            insert_leaf(BPlusTreeRangeSearch(this->root, data), std::move(data));
+        }
+    }
 
-            //overflow check
-            if(cursor->size < (this->degree-1)){ // not overflow, just insert in the correct position
-                //item insert and rearrange
-                cursor->item = item_insert(cursor->item,data,cursor->size);
-                cursor->size++;
-                //edit pointer(next node)
-                cursor->children[cursor->size] = cursor->children[cursor->size-1];
-                cursor->children[cursor->size-1] = nullptr;
-            }
-            else{//overflow case
-                //make new node
-                auto* Newnode = new Node<T>(this->degree);
-                Newnode->is_leaf = true;
-                Newnode->parent = cursor->parent;
+    // Thread-safe insert: exclusive latches top-down, letting go of everything above a node
+    // that has room for one more item, since a split can't climb past it.
+    void insert_latched(T&& data) {
+        read_lock();
+        this->root_latch.lock();
+        if(this->root == nullptr){
+            this->root = new_node();
+            this->root->is_leaf = true;
+            this->root->item[0] = std::move(data);
+            this->root->size = 1;
+            refresh_column(this->root);
+            this->root_latch.unlock();
+            read_unlock();
+            return;
+        }
 
-                //copy item
-                T* item_copy = new T[cursor->size+1];
-                for(int i=0; i<cursor->size; i++){
-                    item_copy[i] = cursor->item[i];
+        std::vector<Node<T, Fanout, Aggregate>*> held;
+        bool root_held = true;
+        Node<T, Fanout, Aggregate>* cursor = this->root;
+        while(true){
+            cursor->latch.lock();
+            if(cursor->size < this->degree-1){ //safe: release the ancestors
+                for(Node<T, Fanout, Aggregate>* node : held){
+                    node->latch.unlock();
                 }
+                held.clear();
+                if(root_held){
+                    this->root_latch.unlock();
+                    root_held = false;
+                }
+            }
+            held.push_back(cursor);
+            if(cursor->is_leaf){
+                break;
+            }
+            cursor = cursor->children[node_rank<true>(cursor, data)];
+        }
 
-                //insert and rearrange
-                item_copy = item_insert(item_copy,data,cursor->size);
+        insert_leaf(cursor, std::move(data));
 
-                //split nodes
-                cursor->size = (this->degree)/2;
-                if((this->degree) % 2 == 0){
-                    Newnode->size = (this->degree) / 2;
-                }
-                else{
-                    Newnode->size = (this->degree) / 2 + 1;
-                }
+        for(Node<T, Fanout, Aggregate>* node : held){
+            node->latch.unlock();
+        }
+        if(root_held){
+            this->root_latch.unlock();
+        }
+        read_unlock();
+    }
 
-                for(int i=0; i<cursor->size;i++){
-                    cursor->item[i] = item_copy[i];
-                }
-                for(int i=0; i < Newnode->size; i++){
-                    Newnode->item[i] = item_copy[cursor->size + i];
-                }
+    void insert_leaf(Node<T, Fanout, Aggregate>* cursor, T&& data) {
+        purge(cursor); //items are about to move, and tombstone flags don't move with them
+        augment_path(cursor, data); //ancestors gain data whatever splits; split nodes are refreshed
+        //overflow check
+        if(cursor->size < (this->degree-1)){ // not overflow, just insert in the correct position
+            //item insert and rearrange
+            int index = 0;
+            if constexpr (columnar) {
+                index = node_rank<true>(cursor, data); // where item_insert puts it
+                move_column(cursor, index, cursor->size, cursor, index + 1);
+                cursor->column[index] = BPlusTreeKey<T>::column(data);
+            }
+            cursor->item = item_insert(cursor->item,std::move(data),cursor->size);
+            cursor->size++;
+            //edit pointer(next node)
+            cursor->children[cursor->size] = cursor->children[cursor->size-1];
+            cursor->children[cursor->size-1] = nullptr;
+        }
+        else{//overflow case
+            BPLUSTREE_COUNT(splits, 1);
+            //make new node
+            auto* Newnode = new_node();
+            Newnode->is_leaf = true;
+            Newnode->parent = cursor->parent;
 
-                cursor->children[cursor->size] = Newnode;
-                Newnode->children[Newnode->size] = cursor->children[this->degree-1];
-                cursor->children[this->degree-1] = nullptr;
+            //split in place: the full leaf plus data form degree items, the upper part moves to Newnode
+            Node<T, Fanout, Aggregate>* next = cursor->children[cursor->size];
+            int index = node_rank<true>(cursor, data); // position of data among the items
+            int left_size = (this->degree)/2;
+            if((this->degree) % 2 == 0){
+                Newnode->size = (this->degree) / 2;
+            }
+            else{
+                Newnode->size = (this->degree) / 2 + 1;
+            }
 
-                delete[] item_copy;
+            for(int j=left_size; j<this->degree; j++){
+                Newnode->item[j-left_size] = std::move(j < index ? cursor->item[j] : (j == index ? data : cursor->item[j-1]));
+            }
+            if(index < left_size){
+                std::move_backward(cursor->item + index, cursor->item + left_size - 1, cursor->item + left_size);
+                cursor->item[index] = std::move(data);
+            }
+            cursor->children[cursor->size] = nullptr;
+            cursor->size = left_size;
 
-                //parent check
-                T paritem = Newnode->item[0];
+            cursor->children[cursor->size] = Newnode;
+            Newnode->children[Newnode->size] = next;
+            refresh(cursor);
+            refresh(Newnode);
+            refresh_column(cursor);
+            refresh_column(Newnode);
 
-                if(cursor->parent == nullptr){//if there are no parent node(root case)
-                    auto* Newparent = new Node<T>(this->degree);
-                    cursor->parent = Newparent;
-                    Newnode->parent = Newparent;
+            //parent check
+            T paritem = bptree_separator(cursor->item[cursor->size-1], Newnode->item[0]); //the items stay in the leaves
 
-                    Newparent->item[0] = paritem;
-                    Newparent->size++;
+            if(cursor->parent == nullptr){//if there are no parent node(root case)
+                auto* Newparent = new_node();
+                cursor->parent = Newparent;
+                Newnode->parent = Newparent;
 
-                    Newparent->children[0] = cursor;
-                    Newparent->children[1] = Newnode;
+                Newparent->item[0] = std::move(paritem);
+                Newparent->size++;
 
-                    this->root = Newparent;
-                }
-                else{//if there already have parent node
-                    InsertPar(cursor->parent, Newnode, paritem);
-                }
+                Newparent->children[0] = cursor;
+                Newparent->children[1] = Newnode;
+                refresh(Newparent);
+
+                this->root = Newparent;
+            }
+            else{//if there already have parent node
+                InsertPar(cursor->parent, cursor, Newnode, std::move(paritem));
             }
         }
     }
 
-    void remove(T data) { // Remove an item from the tree.
-        //make cursor
-        Node<T>* cursor = this->root;
-
-        //move to leaf node
-        cursor = BPlusTreeRangeSearch(cursor,data);
+    // Build the tree bottom-up from the sorted range [first, last), replacing its contents.
+    // Leaves are packed to fill_factor of their capacity (clamped so they never start underfull),
+    // then each internal level is built over the one below it in a single pass.
+    template<typename It>
+    void bulk_load(It first, It last, double fill_factor = 1.0) {
+        write_lock();
+        release_all();
+        bulk_build(first, last, fill_factor);
+        write_unlock();
+    }
 
-        //make sibling index
-        int sib_index =-1;
-        for(int i=0; i<cursor->parent->size+1;i++){
-            if(cursor == cursor->parent->children[i]){
-                sib_index = i;
-            }
+    // Sort the items (if they are not sorted already) and bulk load them.
+    void bulk_load(std::vector<T> items, double fill_factor = 1.0) {
+        if(!std::is_sorted(items.begin(), items.end())){
+            std::stable_sort(items.begin(), items.end());
         }
-        int left=sib_index-1;
-        int right=sib_index+1;
-
+        bulk_load(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()), fill_factor);
+    }
 
-        //find data
-        int del_index=-1;
-        for(int i=0; i< cursor->size; i++){
-            if(cursor->item[i] == data){
-                del_index = i;
-                break;
-            }
+    // Insert a batch of items. They are sorted once and merged into the leaves run by run: the
+    // items bound for one leaf cost a single descent, and a leaf that overflows is split into as
+    // many leaves as it needs at once. Equal items go after those already in the tree, as with
+    // insert. An empty tree is bulk loaded instead.
+    void insert_batch(std::vector<T> items) {
+        if(!std::is_sorted(items.begin(), items.end())){
+            std::stable_sort(items.begin(), items.end());
         }
-        //if data dosen't exist, nothing happen
-        if(del_index==-1){
-            return; // there is no match remove value
+        BPLUSTREE_COUNT(inserts, items.size());
+        write_lock();
+        if(this->root == nullptr){
+            bulk_build(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()), 1.0);
         }
-
-        //remove data
-        for(int i=del_index; i<cursor->size-1;i++){
-            cursor->item[i] = cursor->item[i+1];
+        else{
+            std::vector<T> merged;
+            auto first = items.begin();
+            while(first != items.end()){
+                const T* fence;
+                Node<T, Fanout, Aggregate>* leaf = batch_leaf(*first, fence);
+                auto last = fence == nullptr ? items.end() : std::lower_bound(first + 1, items.end(), *fence);
+                batch_merge(leaf, first, last, merged);
+                first = last;
+            }
         }
-        cursor->item[cursor->size-1] = 0;
-        cursor->size--;
+        write_unlock();
+    }
 
-        //if cursor is root, and there are no more data -> clean!
-        if(cursor == this->root && cursor->size==0){//root case
-            clear(this->root);
-            this->root = nullptr;
-            return;
+    // Leaf where key would be inserted, and the separator bounding that leaf on the right (null
+    // for the last leaf): the keys after key that are less than *fence belong to the same leaf.
+    Node<T, Fanout, Aggregate>* batch_leaf(const T& key, const T*& fence){
+        Node<T, Fanout, Aggregate>* cursor = this->root;
+        fence = nullptr;
+        while(!cursor->is_leaf){
+            int index = node_rank<true>(cursor, key);
+            if(index < cursor->size){
+                fence = &cursor->item[index];
+            }
+            cursor = cursor->children[index];
         }
-        cursor->children[cursor->size] = cursor->children[cursor->size+1];
-        cursor->children[cursor->size+1] = nullptr;
-
+        return cursor;
+    }
 
-        //underflow check
-        if(cursor == this->root){
+    // Merge the sorted items [first, last) into leaf, splitting it into evenly filled leaves
+    // when they don't fit. merged is scratch space kept across runs.
+    template<typename It>
+    void batch_merge(Node<T, Fanout, Aggregate>* leaf, It first, It last, std::vector<T>& merged){
+        purge(leaf);
+        int run = static_cast<int>(last - first);
+        int total = leaf->size + run;
+        Node<T, Fanout, Aggregate>* next = leaf->children[leaf->size];
+        leaf->children[leaf->size] = nullptr;
+
+        if(total <= this->degree-1){ //fits: merge from the back, the leaf's items first on ties
+            int a = leaf->size - 1;
+            int b = run - 1;
+            for(int out = total-1; b >= 0; out--){
+                if(a >= 0 && first[b] < leaf->item[a]){
+                    leaf->item[out] = std::move(leaf->item[a--]);
+                }
+                else{
+                    leaf->item[out] = std::move(first[b--]);
+                }
+            }
+            leaf->size = total;
+            leaf->children[leaf->size] = next;
+            refresh_column(leaf);
+            refresh_path(leaf);
             return;
         }
-        if(cursor->size < degree/2){//underflow case
-
-            if(left >= 0){// left_sibiling exists
-                Node<T>* leftsibling= cursor->parent->children[left];
 
-                if(leftsibling->size > degree/2){ //if data number is enough to use this node
-                    T* temp = new T[cursor->size+1];
-
-                    //copy item
-                    for(int i=0; i<cursor->size; i++){
-                        temp[i]=cursor->item[i];
-                    }
-
-                    //insert and rearrange
-                    item_insert(temp,leftsibling->item[leftsibling->size -1],cursor->size);
-                    for(int i=0; i<cursor->size+1; i++){
-                        cursor->item[i] = temp[i];
-                    }
-                    cursor->size++;
-                    delete[] temp;
-
-                    //pointer edit
-                    cursor->children[cursor->size] = cursor->children[cursor->size-1];
-                    cursor->children[cursor->size-1] = nullptr;
+        merged.clear();
+        merged.reserve(total);
+        std::merge(std::make_move_iterator(leaf->item), std::make_move_iterator(leaf->item + leaf->size),
+                   std::make_move_iterator(first), std::make_move_iterator(last), std::back_inserter(merged));
+
+        std::size_t leaf_count = (merged.size() + this->degree - 2) / (this->degree - 1);
+        BPLUSTREE_COUNT(splits, leaf_count - 1);
+        std::vector<Node<T, Fanout, Aggregate>*> leaves;
+        leaves.reserve(leaf_count);
+        std::size_t pos = 0;
+        Node<T, Fanout, Aggregate>* cursor = leaf;
+        for(std::size_t n=0; n<leaf_count; n++){
+            Node<T, Fanout, Aggregate>* node = n == 0 ? leaf : new_node();
+            node->is_leaf = true;
+            node->size = merged.size() / leaf_count + (n < merged.size() % leaf_count ? 1 : 0); // spread evenly
+            for(int i=0; i<node->size; i++){
+                node->item[i] = std::move(merged[pos++]);
+            }
+            refresh(node);
+            refresh_column(node);
+            leaves.push_back(node);
+            if(n > 0){
+                cursor->children[cursor->size] = node; //next pointer
+                node->parent = cursor->parent;
+                T paritem = bptree_separator(cursor->item[cursor->size-1], node->item[0]);
+                if(cursor->parent == nullptr){//root case
+                    auto* Newparent = new_node();
+                    cursor->parent = Newparent;
+                    node->parent = Newparent;
 
-                    //sibling property edit
-                    leftsibling->item[leftsibling->size-1] = 0;
-                    leftsibling->size--;
-                    leftsibling->children[leftsibling->size] = leftsibling->children[leftsibling->size+1]; //cursor
-                    leftsibling->children[leftsibling->size+1]= nullptr;
+                    Newparent->item[0] = std::move(paritem);
+                    Newparent->size++;
 
-                    //parent property edit
-                    cursor->parent->item[left] = cursor->item[0];
+                    Newparent->children[0] = cursor;
+                    Newparent->children[1] = node;
+                    refresh(Newparent);
 
-                    return;
+                    this->root = Newparent;
+                }
+                else{
+                    InsertPar(cursor->parent, cursor, node, std::move(paritem));
                 }
             }
-            if(right <= cursor->parent->size){// right_sibiling exists
-                Node<T>* rightsibling = cursor->parent->children[right];
-
-                if(rightsibling->size >degree/2){//if data number is enough to use this node
-                    T* temp = new T[cursor->size+1];
+            cursor = node;
+        }
+        cursor->children[cursor->size] = next;
+        //every node that gained items is above one of the leaves; in order, each ends up
+        //recomputed after all the nodes below it
+        for(Node<T, Fanout, Aggregate>* node : leaves){
+            refresh_path(node);
+        }
+    }
 
-                    //copy item
-                    for(int i=0; i<cursor->size; i++){
-                        temp[i]=cursor->item[i];
-                    }
-                    //insert and rearrange
-                    item_insert(temp,rightsibling->item[0],cursor->size);
-                    for(int i=0; i<cursor->size+1; i++){
-                        cursor->item[i] = temp[i];
-                    }
-                    cursor->size++;
-                    delete[] temp;
+    // Build the tree from the sorted range [first, last) into an empty tree; the caller holds
+    // the tree latch.
+    template<typename It>
+    void bulk_build(It first, It last, double fill_factor) {
+        std::size_t count = std::distance(first, last);
+        if(count == 0){
+            return;
+        }
 
-                    //pointer edit
-                    cursor->children[cursor->size] = cursor->children[cursor->size-1];
-                    cursor->children[cursor->size-1] = nullptr;
+        //leaf level
+        std::size_t leaf_min = std::max<std::size_t>(1, this->degree/2);
+        std::size_t leaf_cap = bulk_capacity(this->degree-1, leaf_min, fill_factor);
+        std::size_t leaf_count = bulk_nodes(count, leaf_cap, leaf_min);
+
+        std::vector<Node<T, Fanout, Aggregate>*> level;
+        std::vector<const T*> level_min; // smallest and largest key under each node of the level
+        std::vector<const T*> level_max;
+        level.reserve(leaf_count);
+        level_min.reserve(leaf_count);
+        level_max.reserve(leaf_count);
+
+        Node<T, Fanout, Aggregate>* prev = nullptr;
+        for(std::size_t n=0; n<leaf_count; n++){
+            auto* leaf = new_node();
+            leaf->is_leaf = true;
+            leaf->size = count / leaf_count + (n < count % leaf_count ? 1 : 0); // spread evenly
+            for(int i=0; i<leaf->size; i++, ++first){
+                leaf->item[i] = *first;
+            }
+            if(prev != nullptr){
+                prev->children[prev->size] = leaf; //next pointer
+            }
+            refresh(leaf);
+            refresh_column(leaf);
+            prev = leaf;
+            level.push_back(leaf);
+            level_min.push_back(&leaf->item[0]);
+            level_max.push_back(&leaf->item[leaf->size-1]);
+        }
 
-                    //sibling property edit
-                    for(int i=0; i<rightsibling->size-1;i++){
-                        rightsibling->item[i] = rightsibling->item[i+1];
+        //internal levels
+        std::size_t child_min = std::max<std::size_t>(2, (this->degree+1)/2);
+        std::size_t child_cap = bulk_capacity(this->degree, child_min, fill_factor);
+        while(level.size() > 1){
+            std::size_t node_count = bulk_nodes(level.size(), child_cap, child_min);
+            std::vector<Node<T, Fanout, Aggregate>*> upper;
+            std::vector<const T*> upper_min;
+            std::vector<const T*> upper_max;
+            upper.reserve(node_count);
+            upper_min.reserve(node_count);
+            upper_max.reserve(node_count);
+
+            std::size_t next = 0;
+            for(std::size_t n=0; n<node_count; n++){
+                std::size_t children = level.size() / node_count + (n < level.size() % node_count ? 1 : 0);
+                auto* node = new_node();
+                for(std::size_t c=0; c<children; c++, next++){
+                    node->children[c] = level[next];
+                    level[next]->parent = node;
+                    if(c > 0){
+                        node->item[c-1] = bptree_separator(*level_max[next-1], *level_min[next]);
                     }
-                    rightsibling->item[rightsibling->size-1] = 0;
-                    rightsibling->size--;
-                    rightsibling->children[rightsibling->size] = rightsibling->children[rightsibling->size+1]; //cursor
-                    rightsibling->children[rightsibling->size+1]= nullptr;
-
-                    //parent property edit
-                    cursor->parent->item[right-1] = rightsibling->item[0];
-
-                    return;
                 }
+                node->size = children - 1;
+                refresh(node);
+                upper.push_back(node);
+                upper_min.push_back(level_min[next - children]);
+                upper_max.push_back(level_max[next - 1]);
             }
+            level.swap(upper);
+            level_min.swap(upper_min);
+            level_max.swap(upper_max);
+        }
+        this->root = level[0];
+    }
 
-            //if sibling is not enought to use their data
-            //we have to merge step
+    std::size_t bulk_capacity(std::size_t max, std::size_t min, double fill_factor){
+        auto cap = static_cast<std::size_t>(fill_factor * max);
+        return std::min(max, std::max(min, cap));
+    }
+    // Nodes needed for count entries at cap per node, but never so many that spreading the
+    // entries evenly leaves a node under min (that node would be underfull for remove).
+    std::size_t bulk_nodes(std::size_t count, std::size_t cap, std::size_t min){
+        return std::min((count + cap - 1) / cap, std::max<std::size_t>(1, count / min));
+    }
 
-            if(left>=0){ // left_sibling exists
-                Node<T>* leftsibling = cursor->parent->children[left];
+    void remove(const T& data) { // Remove an item from the tree.
+        BPLUSTREE_COUNT(removes, 1);
+        write_lock();
+        remove_item(data);
+        write_unlock();
+    }
 
-                //merge two leaf node
-                for(int i=0; i<cursor->size; i++){
-                    leftsibling->item[leftsibling->size+i]=cursor->item[i];
-                }
-                //edit pointer
-                leftsibling->children[leftsibling->size] = nullptr;
-                leftsibling->size = leftsibling->size+cursor->size;
-                leftsibling->children[leftsibling->size] = cursor->children[cursor->size];
+    // Mark the first live item equal to data as deleted without moving anything: scans skip it,
+    // and its slot is reclaimed when its leaf next changes or by compact(). Much cheaper than
+    // remove for mass deletes, at the price of leaves that stay underfull until compact().
+    // Augmented trees keep exact counts and must use remove. False if data is not there.
+    bool tombstone(const T& data) {
+        static_assert(!augmented, "tombstones would break the subtree counts; use remove");
+        BPLUSTREE_COUNT(removes, 1);
+        write_lock();
+        int index;
+        Node<T, Fanout, Aggregate>* leaf = BPlusTreeSearch(this->root, data, index);
+        if(leaf != nullptr){
+            mark_dead(leaf, index);
+        }
+        write_unlock();
+        return leaf != nullptr;
+    }
 
-                //parent property edit
-                Removepar(cursor, left, cursor->parent);
-                for(int i=0; i<cursor->size;i++){
-                    cursor->item[i]=0;
-                    cursor->children[i] = nullptr;
+    // Tombstone every item from lower_bound(start) while item <= end (the bounds of
+    // range_for_each) and return how many there were.
+    std::size_t erase_range(const T& start, const T& end) {
+        static_assert(!augmented, "tombstones would break the subtree counts; use remove");
+        write_lock();
+        std::size_t erased = 0;
+        Node<T, Fanout, Aggregate>* leaf = BPlusTreeLowerSearch(this->root, start);
+        int index = leaf != nullptr ? node_rank<false>(leaf, start) : 0;
+        for(; leaf != nullptr; leaf = leaf->children[leaf->size], index = 0){
+            for(int i=index; i<leaf->size; i++){
+                if(!(leaf->item[i] <= end)){
+                    leaf = nullptr;
+                    break;
                 }
-                cursor->children[cursor->size] = nullptr;
-
-                delete[] cursor->item;
-                delete[] cursor->children;
-                delete cursor;
-
-                return;
-
-            }
-            if(right<=cursor->parent->size){ // right_sibiling exists
-                Node<T>* rightsibling = cursor->parent->children[right];
-
-                //merge two leaf node
-                for(int i=0; i<rightsibling->size; i++){
-                    cursor->item[i+cursor->size]=rightsibling->item[i];
+                if(!leaf->dead[i]){
+                    mark_dead(leaf, i);
+                    erased++;
                 }
-                //edit pointer
-                cursor->children[cursor->size] = nullptr;
-                cursor->size = rightsibling->size+cursor->size;
-                cursor->children[cursor->size] = rightsibling->children[rightsibling->size];
-
-                //parent property edit
-                Removepar(rightsibling, right-1, cursor->parent);
+            }
+            if(leaf == nullptr){
+                break;
+            }
+        }
+        BPLUSTREE_COUNT(removes, erased);
+        write_unlock();
+        return erased;
+    }
 
-                for(int i=0; i<rightsibling->size;i++){
-                    rightsibling->item[i]=0;
-                    rightsibling->children[i] = nullptr;
+    // Rebuild the tree from its live items, packed to fill_factor like bulk_load: tombstones are
+    // gone and so are the underfull leaves deletes left behind. Stop-the-world: it holds the
+    // write lock for the whole rebuild, and the live items sit in a vector next to the old nodes
+    // until those are released. compact_step does the same work online, a few leaves at a time.
+    void compact(double fill_factor = 1.0) {
+        write_lock();
+        Node<T, Fanout, Aggregate>* first = this->root;
+        while(first != nullptr && !first->is_leaf){
+            first = first->children[0];
+        }
+        std::size_t count = 0;
+        for(Node<T, Fanout, Aggregate>* leaf = first; leaf != nullptr; leaf = leaf->children[leaf->size]){
+            count += leaf->size - leaf->tombstones;
+        }
+        std::vector<T> live;
+        live.reserve(count);
+        for(Node<T, Fanout, Aggregate>* leaf = first; leaf != nullptr; leaf = leaf->children[leaf->size]){
+            for(int i=0; i<leaf->size; i++){
+                if(!leaf->dead[i]){
+                    live.push_back(std::move(leaf->item[i]));
                 }
-                rightsibling->children[rightsibling->size] = nullptr;
-
-                delete[] rightsibling->item;
-                delete[] rightsibling->children;
-                delete rightsibling;
-                return;
+            }
+        }
+        release_all();
+        bulk_build(std::make_move_iterator(live.begin()), std::make_move_iterator(live.end()), fill_factor);
+        this->compact_next = nullptr;
+        write_unlock();
+    }
 
+    // One step of an online compaction: purge the tombstones of the next `leaves` leaves and
+    // bring each one left underfull back to half full, borrowing from or merging with its
+    // neighbours in place. The write lock is held for the step only, so lookups, scans and
+    // inserts run between steps; nothing is copied out of the tree. Each step resumes after the
+    // last leaf of the previous one. Returns true when the step reached the last leaf (the next
+    // step starts over from the first).
+    bool compact_step(std::size_t leaves = 64) {
+        write_lock();
+        Node<T, Fanout, Aggregate>* leaf = this->compact_next;
+        if(leaf != nullptr && this->frees != this->compact_frees){ // a node may be gone: find it again
+            leaf = BPlusTreeLowerSearch(this->root, this->compact_key);
+        }
+        if(leaf == nullptr){
+            leaf = this->root;
+            while(leaf != nullptr && !leaf->is_leaf){
+                leaf = leaf->children[0];
             }
+        }
+        for(std::size_t done = 0; leaf != nullptr && done < leaves; done++){
+            purge(leaf);
+            leaf = refill(leaf);
+            leaf = leaf != nullptr ? leaf->children[leaf->size] : nullptr;
+        }
+        this->compact_next = leaf;
+        if(leaf != nullptr){
+            this->compact_key = leaf->item[0];
+            this->compact_frees = this->frees;
+        }
+        write_unlock();
+        return leaf == nullptr;
+    }
 
+    // Bring a purged leaf back to the minimum size: borrow items from a sibling one at a time, or
+    // merge with it once the sibling has none to spare. Returns the leaf that now holds leaf's
+    // items (its left sibling after a merge into it), or nullptr when the tree became empty.
+    Node<T, Fanout, Aggregate>* refill(Node<T, Fanout, Aggregate>* leaf){
+        int min_size = this->degree/2;
+        while(leaf != this->root && leaf->size < min_size){
+            Node<T, Fanout, Aggregate>* par = leaf->parent;
+            int index = 0;
+            while(par->children[index] != leaf){
+                index++;
+            }
+            Node<T, Fanout, Aggregate>* left = index > 0 ? par->children[index-1] : nullptr;
+            Node<T, Fanout, Aggregate>* right = index < par->size ? par->children[index+1] : nullptr;
+            purge(left);
+            purge(right);
+            if(left != nullptr && left->size > min_size){
+                borrow_left(leaf, left, par, index-1);
+                refresh(left);
+                refresh_path(leaf);
+            }
+            else if(right != nullptr && right->size > min_size){
+                borrow_right(leaf, right, par, index);
+                refresh(right);
+                refresh_path(leaf);
+            }
+            else if(left != nullptr){ // the pair may still be short: go on from the merged leaf
+                merge(left, leaf, par, index-1);
+                refresh(left);
+                rebalance(par);
+                leaf = left;
+            }
+            else{
+                merge(leaf, right, par, index);
+                refresh(leaf);
+                rebalance(par);
+            }
         }
-        else{
-            return;
+        if(leaf == this->root){
+            rebalance(leaf);
+            return this->root;
         }
+        return leaf;
     }
 
-    void Removepar(Node<T>* node, int index, Node<T>* par){
-        Node<T>* remover = node;
-        Node<T>* cursor = par;
-        T target = cursor->item[index];
+    // Tombstoned items still taking up slots.
+    std::size_t tombstones() const {
+        return this->tombstone_count;
+    }
 
-        //if cursor is root, and there are no more data -> child node is to be root!
-        if(cursor == this->root && cursor->size==1){//root case
-            if(remover == cursor->children[0]){
-                delete[] remover->item;
-                delete[] remover->children;
-                delete remover;
-                this->root = cursor->children[1];
-                delete[] cursor->item;
-                delete[] cursor->children;
-                delete cursor;
-                return;
+    void mark_dead(Node<T, Fanout, Aggregate>* leaf, int index){
+        leaf->dead[index] = 1;
+        leaf->tombstones++;
+        this->tombstone_count++;
+    }
+    // Drop the tombstoned items of leaf (if any) for good, closing the gaps.
+    void purge(Node<T, Fanout, Aggregate>* leaf){
+        if(leaf == nullptr || leaf->tombstones == 0){
+            return;
+        }
+        Node<T, Fanout, Aggregate>* next = leaf->children[leaf->size];
+        leaf->children[leaf->size] = nullptr;
+        int kept = 0;
+        for(int i=0; i<leaf->size; i++){
+            if(!leaf->dead[i]){
+                if(kept != i){
+                    leaf->item[kept] = std::move(leaf->item[i]);
+                    move_column(leaf, i, i + 1, leaf, kept);
+                }
+                kept++;
             }
-            if(remover == cursor->children[1]){
-                delete[] remover->item;
-                delete[] remover->children;
-                delete remover;
-                this->root = cursor->children[0];
-                delete[] cursor->item;
-                delete[] cursor->children;
-                delete cursor;
-                return;
+            leaf->dead[i] = 0;
+        }
+        this->tombstone_count -= leaf->tombstones;
+        leaf->tombstones = 0;
+        leaf->size = kept;
+        leaf->children[leaf->size] = next; //next pointer
+    }
+
+    // Remove the first item equal to data. A node left underfull borrows an item from a sibling
+    // or merges with it; a merge takes a separator out of the parent, which may cascade up.
+    void remove_item(const T& data) {
+        int del_index;
+        Node<T, Fanout, Aggregate>* cursor = BPlusTreeSearch(this->root, data, del_index);
+        if(cursor == nullptr){
+            return; // there is no match remove value
+        }
+        if(cursor->tombstones != 0){
+            purge(cursor);
+            del_index = node_rank<false>(cursor, data);
+            while(!(cursor->item[del_index] == data)){
+                del_index++;
             }
         }
 
         //remove data
-        for(int i=index; i<cursor->size-1;i++){
-            cursor->item[i] = cursor->item[i+1];
-        }
-        cursor->item[cursor->size-1] = 0;
+        std::move(cursor->item + del_index + 1, cursor->item + cursor->size, cursor->item + del_index);
+        move_column(cursor, del_index + 1, cursor->size, cursor, del_index);
+        cursor->size--;
+        cursor->children[cursor->size] = cursor->children[cursor->size+1]; //next pointer
+        cursor->children[cursor->size+1] = nullptr;
 
-        //remove pointer
-        int rem_index = -1;
-        for(int i=0; i<cursor->size+1;i++){
-            if(cursor->children[i] == remover){
-                rem_index = i;
+        rebalance(cursor);
+    }
+
+    // node lost an item (leaf) or a separator and a child (internal node): restore its minimum
+    // size and the summaries from node up to the root.
+    void rebalance(Node<T, Fanout, Aggregate>* node){
+        if(node == this->root){//root case
+            if(node->size > 0){
+                refresh(node);
+            }
+            else if(node->is_leaf){ //no more data -> clean!
+                free_node(node);
+                this->root = nullptr;
+            }
+            else{ //only child becomes the root
+                this->root = node->children[0];
+                this->root->parent = nullptr;
+                free_node(node);
             }
+            return;
         }
-        if(rem_index == -1){
+        int min_size = node->is_leaf ? this->degree/2 : (this->degree-1)/2;
+        if(node->size >= min_size){
+            refresh_path(node);
             return;
         }
-        for(int i=rem_index; i<cursor->size;i++){
-            cursor->children[i] = cursor->children[i+1];
+
+        //underflow case
+        Node<T, Fanout, Aggregate>* par = node->parent;
+        int index = 0;
+        while(par->children[index] != node){
+            index++;
+        }
+        Node<T, Fanout, Aggregate>* left = index > 0 ? par->children[index-1] : nullptr;
+        Node<T, Fanout, Aggregate>* right = index < par->size ? par->children[index+1] : nullptr;
+        if(node->is_leaf){ //items may move between the leaves
+            purge(left);
+            purge(right);
         }
-        cursor->children[cursor->size] = nullptr;
-        cursor->size--;
 
-        //underflow check
-        if(cursor == this->root){
-            return;
+        if(left != nullptr && left->size > min_size){ //sibling has enough data to lend one
+            borrow_left(node, left, par, index-1);
+            refresh(left);
+            refresh_path(node);
+        }
+        else if(right != nullptr && right->size > min_size){
+            borrow_right(node, right, par, index);
+            refresh(right);
+            refresh_path(node);
+        }
+        else if(left != nullptr){ //merge step
+            merge(left, node, par, index-1);
+            refresh(left);
+            rebalance(par);
         }
-        if(cursor->size < degree/2){//underflow case
+        else{
+            merge(node, right, par, index);
+            refresh(node);
+            rebalance(par);
+        }
+    }
 
-            int sib_index =-1;
-            for(int i=0; i<cursor->parent->size+1;i++){
-                if(cursor == cursor->parent->children[i]){
-                    sib_index = i;
-                }
+    // Move the last item of left to the front of node; par->item[sep] separates them.
+    void borrow_left(Node<T, Fanout, Aggregate>* node, Node<T, Fanout, Aggregate>* left, Node<T, Fanout, Aggregate>* par, int sep){
+        BPLUSTREE_COUNT(borrows, 1);
+        std::move_backward(node->item, node->item + node->size, node->item + node->size + 1);
+        if(node->is_leaf){
+            move_column(node, 0, node->size, node, 1);
+            move_column(left, left->size - 1, left->size, node, 0);
+            node->item[0] = std::move(left->item[left->size-1]);
+            node->size++;
+            node->children[node->size] = node->children[node->size-1]; //next pointer
+            node->children[node->size-1] = nullptr;
+
+            left->size--;
+            left->children[left->size] = left->children[left->size+1];
+            left->children[left->size+1] = nullptr;
+            par->item[sep] = bptree_separator(left->item[left->size-1], node->item[0]);
+        }
+        else{ //the separator comes down, left's last item goes up
+            node->item[0] = std::move(par->item[sep]);
+            for(int i=node->size+1; i>0; i--){
+                node->children[i] = node->children[i-1];
             }
-            int left=sib_index-1;
-            int right=sib_index+1;
+            node->children[0] = left->children[left->size];
+            node->children[0]->parent = node;
+            node->size++;
 
-            if(left >= 0){// left_sibiling exists
-                Node<T>* leftsibling= cursor->parent->children[left];
+            par->item[sep] = std::move(left->item[left->size-1]);
+            left->children[left->size] = nullptr;
+            left->size--;
+        }
+    }
 
-                if(leftsibling->size > degree/2){ //if data number is enough to use this node
-                    T* temp = new T[cursor->size+1];
+    // Move the first item of right to the back of node; par->item[sep] separates them.
+    void borrow_right(Node<T, Fanout, Aggregate>* node, Node<T, Fanout, Aggregate>* right, Node<T, Fanout, Aggregate>* par, int sep){
+        BPLUSTREE_COUNT(borrows, 1);
+        if(node->is_leaf){
+            node->item[node->size] = std::move(right->item[0]);
+            move_column(right, 0, 1, node, node->size);
+            node->size++;
+            node->children[node->size] = node->children[node->size-1]; //next pointer
+            node->children[node->size-1] = nullptr;
+
+            std::move(right->item + 1, right->item + right->size, right->item);
+            move_column(right, 1, right->size, right, 0);
+            right->size--;
+            right->children[right->size] = right->children[right->size+1];
+            right->children[right->size+1] = nullptr;
+            par->item[sep] = bptree_separator(node->item[node->size-1], right->item[0]);
+        }
+        else{ //the separator comes down, right's first item goes up
+            node->item[node->size] = std::move(par->item[sep]);
+            node->children[node->size+1] = right->children[0];
+            node->children[node->size+1]->parent = node;
+            node->size++;
+
+            par->item[sep] = std::move(right->item[0]);
+            std::move(right->item + 1, right->item + right->size, right->item);
+            for(int i=0; i<right->size; i++){
+                right->children[i] = right->children[i+1];
+            }
+            right->children[right->size] = nullptr;
+            right->size--;
+        }
+    }
 
-                    //copy item
-                    for(int i=0; i<cursor->size; i++){
-                        temp[i]=cursor->item[i];
-                    }
+    // Append right to left and drop right with its separator par->item[sep] from par.
+    void merge(Node<T, Fanout, Aggregate>* left, Node<T, Fanout, Aggregate>* right, Node<T, Fanout, Aggregate>* par, int sep){
+        BPLUSTREE_COUNT(merges, 1);
+        if(left->is_leaf){
+            std::move(right->item, right->item + right->size, left->item + left->size);
+            move_column(right, 0, right->size, left, left->size);
+            left->children[left->size] = nullptr;
+            left->size += right->size;
+            left->children[left->size] = right->children[right->size]; //next pointer
+        }
+        else{ //the separator comes down between the two halves
+            left->item[left->size] = std::move(par->item[sep]);
+            std::move(right->item, right->item + right->size, left->item + left->size + 1);
+            for(int i=0; i<=right->size; i++){
+                left->children[left->size+1+i] = right->children[i];
+                right->children[i]->parent = left;
+            }
+            left->size += right->size + 1;
+        }
 
-                    //insert and rearrange at cursor
-                    item_insert(temp, cursor->parent->item[left],cursor->size);
-                    for(int i=0; i<cursor->size+1; i++){
-                        cursor->item[i] = temp[i];
-                    }
-                    cursor->parent->item[left] = leftsibling->item[leftsibling->size-1];
-                    delete[] temp;
+        //parent property edit
+        std::move(par->item + sep + 1, par->item + par->size, par->item + sep);
+        for(int i=sep+1; i<par->size; i++){
+            par->children[i] = par->children[i+1];
+        }
+        par->children[par->size] = nullptr;
+        par->size--;
+        free_node(right);
+    }
 
-                    Node<T>** child_temp = new Node<T>*[cursor->size+2];
-                    //copy child node
-                    for(int i=0; i<cursor->size+1; i++){
-                        child_temp[i]=cursor->children[i];
-                    }
-                    //insert and rearrange at child
-                    child_insert(child_temp,leftsibling->children[leftsibling->size],cursor->size,0);
+    iterator begin(){
+        Node<T, Fanout, Aggregate>* cursor = this->root;
+        if(cursor == nullptr){
+            return end();
+        }
+        while(!cursor->is_leaf){
+            cursor = cursor->children[0];
+        }
+        return iterator(cursor, 0);
+    }
+    iterator end(){
+        return iterator();
+    }
 
-                    for(int i=0; i<cursor->size+2; i++){
-                        cursor->children[i] = child_temp[i];
-                    }
-                    delete[] child_temp;
+    // First item not less than key.
+    iterator lower_bound(const T& key){
+        BPLUSTREE_COUNT(lookups, 1);
+        Node<T, Fanout, Aggregate>* cursor = BPlusTreeLowerSearch(this->root, key);
+        if(cursor == nullptr){
+            return end();
+        }
+        return iterator(cursor, node_rank<false>(cursor, key));
+    }
+    // First item greater than key.
+    iterator upper_bound(const T& key){
+        BPLUSTREE_COUNT(lookups, 1);
+        Node<T, Fanout, Aggregate>* cursor = BPlusTreeRangeSearch(this->root, key);
+        if(cursor == nullptr){
+            return end();
+        }
+        return iterator(cursor, node_rank<true>(cursor, key));
+    }
+    std::pair<iterator, iterator> equal_range(const T& key){
+        return {lower_bound(key), upper_bound(key)};
+    }
 
-                    //size edit
-                    cursor->size++;
-                    leftsibling->size--;
-                    return;
+    // Number of items. Augmented trees only, like everything down to range_aggregate.
+    std::size_t size(){
+        static_assert(augmented, "size() needs an augmented tree");
+        read_lock();
+        std::size_t count = this->root != nullptr ? this->root->count : 0;
+        read_unlock();
+        return count;
+    }
+    // Number of items less than key.
+    std::size_t rank(const T& key){
+        read_lock();
+        std::size_t count = count_while([&](const T& item){ return item < key; });
+        read_unlock();
+        return count;
+    }
+    // The k-th item in key order (from 0), or end().
+    iterator select(std::size_t k){
+        static_assert(augmented, "select() needs an augmented tree");
+        read_lock();
+        Node<T, Fanout, Aggregate>* cursor = this->root;
+        if(cursor == nullptr || k >= cursor->count){
+            read_unlock();
+            return end();
+        }
+        while(!cursor->is_leaf){
+            int i = 0;
+            while(k >= cursor->children[i]->count){
+                k -= cursor->children[i]->count;
+                i++;
+            }
+            cursor = cursor->children[i];
+        }
+        read_unlock();
+        return iterator(cursor, k);
+    }
+    // Number of items range_for_each(start, end, ...) would visit.
+    std::size_t range_count(const T& start, const T& end){
+        read_lock();
+        std::size_t first = count_while([&](const T& item){ return item < start; });
+        std::size_t last = count_while([&](const T& item){ return item <= end; });
+        read_unlock();
+        return last > first ? last - first : 0;
+    }
+    // Aggregate summary of the items range_for_each(start, end, ...) would visit.
+    auto range_aggregate(const T& start, const T& end){
+        read_lock();
+        std::size_t first = count_while([&](const T& item){ return item < start; });
+        std::size_t last = count_while([&](const T& item){ return item <= end; });
+        auto summary = aggregate_positions(this->root, first, last);
+        read_unlock();
+        return summary;
+    }
 
+    // Number of leading items for which pred holds. pred must hold for a prefix of the key
+    // order (separators included), so whole children can be counted without visiting them.
+    template<typename Pred>
+    std::size_t count_while(Pred pred){
+        static_assert(augmented, "counting needs an augmented tree");
+        std::size_t count = 0;
+        Node<T, Fanout, Aggregate>* cursor = this->root;
+        while(cursor != nullptr){
+            int low = 0, len = cursor->size; // first item for which pred fails
+            while(len > 0){
+                int half = len / 2;
+                if(pred(cursor->item[low + half])){
+                    low += half + 1;
+                    len -= half + 1;
+                }
+                else{
+                    len = half;
                 }
             }
+            if(cursor->is_leaf){
+                return count + low;
+            }
+            for(int i=0; i<low; i++){
+                count += cursor->children[i]->count;
+            }
+            cursor = cursor->children[low];
+        }
+        return count;
+    }
+    // Summary of the items at positions [first, last) under node.
+    auto aggregate_positions(Node<T, Fanout, Aggregate>* node, std::size_t first, std::size_t last){
+        auto summary = Aggregate::identity();
+        if(node == nullptr || first >= last){
+            return summary;
+        }
+        if(first == 0 && last >= node->count){
+            return node->summary;
+        }
+        if(node->is_leaf){
+            for(std::size_t i=first; i<last && i<node->size; i++){
+                summary = Aggregate::combine(summary, Aggregate::of(node->item[i]));
+            }
+            return summary;
+        }
+        std::size_t offset = 0;
+        for(int i=0; i<=node->size && offset < last; i++){
+            Node<T, Fanout, Aggregate>* child = node->children[i];
+            if(offset + child->count > first){
+                summary = Aggregate::combine(summary, aggregate_positions(child, first > offset ? first - offset : 0, last - offset));
+            }
+            offset += child->count;
+        }
+        return summary;
+    }
 
-            if(right <= cursor->parent->size){// right_sibiling exists
-                Node<T>* rightsibling = cursor->parent->children[right];
-
-                if(rightsibling->size > degree/2){//if data number is enough to use this node
-                    T* temp = new T[cursor->size+1];
-
-                    //copy item
-                    for(int i=0; i<cursor->size; i++){
-                        temp[i]=cursor->item[i];
-                    }
-                    //insert and rearrange at cursor
-                    item_insert(temp,cursor->parent->item[sib_index],cursor->size);
-                    for(int i=0; i<cursor->size+1; i++){
-                        cursor->item[i] = temp[i];
-                    }
-                    cursor->parent->item[sib_index] = rightsibling->item[0];
-                    delete[] temp;
-
-                    //insert and reaarange at child
-
-                    cursor->children[cursor->size+1] = rightsibling->children[0];
-                    for(int i=0; i<rightsibling->size; i++){
-                        rightsibling->children[i] = rightsibling->children[i+1];
-                    }
-                    rightsibling->children[rightsibling->size] = nullptr;
-
-                    cursor->size++;
-                    rightsibling->size--;
-                    return;
+    // Call f on every item from lower_bound(start) while item <= end, in order and by reference.
+    // If f returns bool, returning false stops the scan.
+    template<typename Func>
+    void range_for_each(const T& start, const T& end, Func f) {
+        BPLUSTREE_COUNT(lookups, 1);
+        read_lock();
+        Node<T, Fanout, Aggregate>* leaf = find_leaf(&start);
+        if(leaf != nullptr){
+            walk_leaves(leaf, node_rank<false>(leaf, start), [&](T& item){
+                BPLUSTREE_COUNT(comparisons, 1);
+                if(!(item <= end)){
+                    return false;
+                }
+                return visit_item(f, item);
+            });
+        }
+        read_unlock();
+    }
+    // The same, restricted to the items whose column value (see BPlusTreeKey::column) is in
+    // filter. The end bound costs one comparison per leaf, except in the last one, and the filter
+    // runs over the leaf's column: items it rejects are never read.
+    template<typename Func>
+    void range_for_each(const T& start, const T& end, const column_range& filter, Func f) {
+        static_assert(columnar, "filtered scans need a key with a column");
+        BPLUSTREE_COUNT(lookups, 1);
+        read_lock();
+        Node<T, Fanout, Aggregate>* leaf = find_leaf(&start);
+        if(leaf != nullptr){
+            walk_leaf_chain(leaf, node_rank<false>(leaf, start), [&](Node<T, Fanout, Aggregate>* cursor, int index){
+                int stop = leaf_stop(cursor, index, end);
+                return select_leaf(cursor, index, stop, filter, [&](T& item){
+                    return visit_item(f, item);
+                }) && stop == cursor->size;
+            });
+        }
+        read_unlock();
+    }
 
+    // Call f(item); false if f returns bool and returned false.
+    template<typename Func>
+    static bool visit_item(Func& f, T& item){
+        if constexpr (std::is_same<decltype(f(item)), bool>::value) {
+            return f(item);
+        }
+        else {
+            f(item);
+            return true;
+        }
+    }
+    // End of the items of leaf from index on that are <= end: one comparison when the whole
+    // leaf is, a binary search otherwise. On an internal node, the children after it are past end.
+    int leaf_stop(Node<T, Fanout, Aggregate>* leaf, int index, const T& end){
+        BPLUSTREE_COUNT(comparisons, 1);
+        if(leaf->size == 0 || leaf->item[leaf->size-1] <= end){
+            return leaf->size;
+        }
+        int low = index, len = leaf->size - 1 - index; // the last item is past end
+        while(len > 0){
+            BPLUSTREE_COUNT(comparisons, 1);
+            int half = len / 2;
+            if(leaf->item[low + half] <= end){
+                low += half + 1;
+                len -= half + 1;
+            }
+            else{
+                len = half;
+            }
+        }
+        return low;
+    }
+    // Call f on the live items in [index, stop) of leaf whose column value is in filter, until
+    // f returns false; false then. The column is compared four values at a time.
+    template<typename Func>
+    bool select_leaf(Node<T, Fanout, Aggregate>* leaf, int index, int stop, const column_range& filter, Func&& f){
+        int i = index;
+#if defined(__SSE2__)
+        for(; i + 4 <= stop; i += 4){
+            int mask = bptree_simd_select(leaf->column + i, filter.lo, filter.hi);
+            for(int j=i; mask != 0; j++, mask >>= 1){
+                if((mask & 1) && !(leaf->tombstones != 0 && leaf->dead[j]) && !f(leaf->item[j])){
+                    return false;
                 }
             }
+        }
+#endif
+        for(; i<stop; i++){
+            bool selected = filter.lo <= leaf->column[i] && leaf->column[i] <= filter.hi;
+            if(selected && !(leaf->tombstones != 0 && leaf->dead[i]) && !f(leaf->item[i])){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Método para recorrer todos los elementos hoja y aplicar una función
+    template<typename Func>
+    void for_each(Func f) {
+        read_lock();
+        // Buscar la hoja más a la izquierda y recorrer todas las hojas
+        Node<T, Fanout, Aggregate>* cursor = find_leaf(nullptr);
+        if (cursor) {
+            walk_leaves(cursor, 0, [&](T& item) {
+                f(item); // Cambia a pasar referencia
+                return true;
+            });
+        }
+        read_unlock();
+    }
+
+    // Call f on every item, with the leaf chain split into one partition per thread (all hardware
+    // threads by default). f runs concurrently on items of different partitions, each partition
+    // in key order. In thread-safe mode the scan is a reader like range_for_each: inserts can run
+    // alongside, and an item inserted meanwhile may or may not be seen.
+    template<typename Func>
+    void parallel_for_each(Func f, unsigned threads = 0) {
+        read_lock();
+        std::vector<ScanPartition> parts = scan_partitions(nullptr, nullptr, parallel_threads(threads));
+        std::exception_ptr error = run_partitions(parts.size(), [&](std::size_t p){
+            scan_partition(parts[p], nullptr, nullptr, nullptr, f);
+        });
+        read_unlock();
+        if(error){
+            std::rethrow_exception(error);
+        }
+    }
 
-            //if sibling is not enought to use their data
-            //we have to merge step
-            if(left>=0){ // left_sibling exists
-                Node<T>* leftsibling = cursor->parent->children[left];
+    // Fold the items between start and end (same bounds as range_for_each) in parallel. Each
+    // partition starts from a copy of init and folds its items in key order with map(acc, item);
+    // the partition results are then folded left to right into init with reduce(acc, part),
+    // so init must be the identity of reduce.
+    template<typename R, typename Map, typename Reduce>
+    R parallel_range_reduce(const T& start, const T& end, R init, Map map, Reduce reduce, unsigned threads = 0) {
+        return range_reduce(start, end, nullptr, std::move(init), map, reduce, threads);
+    }
+    // The same, restricted to the items whose column value is in filter, as in the filtered
+    // range_for_each.
+    template<typename R, typename Map, typename Reduce>
+    R parallel_range_reduce(const T& start, const T& end, const column_range& filter, R init, Map map, Reduce reduce, unsigned threads = 0) {
+        static_assert(columnar, "filtered scans need a key with a column");
+        return range_reduce(start, end, &filter, std::move(init), map, reduce, threads);
+    }
+    template<typename R, typename Map, typename Reduce>
+    R range_reduce(const T& start, const T& end, const column_range* filter, R init, Map& map, Reduce& reduce, unsigned threads) {
+        read_lock();
+        std::vector<ScanPartition> parts = scan_partitions(&start, &end, parallel_threads(threads));
+        std::vector<R> partial(parts.size());
+        std::exception_ptr error = run_partitions(parts.size(), [&](std::size_t p){
+            R acc = init; // a local accumulator per thread, stored once at the end
+            scan_partition(parts[p], &start, &end, filter, [&](T& item){
+                map(acc, item);
+            });
+            partial[p] = std::move(acc);
+        });
+        read_unlock();
+        if(error){
+            std::rethrow_exception(error);
+        }
+        for(R& part : partial){
+            reduce(init, part);
+        }
+        return init;
+    }
 
-                leftsibling->item[leftsibling->size] = cursor->parent->item[left];
-                //merge two leaf node
-                for(int i=0; i<cursor->size; i++){
-                    leftsibling->item[leftsibling->size+i+1]=cursor->item[i];
+    // A stretch of the leaf chain: from leaf up to, not including, leaf stop. A null leaf is the
+    // one holding lower_bound(start), looked up when the partition runs.
+    struct ScanPartition {
+        Node<T, Fanout, Aggregate>* leaf;
+        Node<T, Fanout, Aggregate>* stop;
+    };
+
+    // Split the items from lower_bound(*start) (or the first item) up to *end (or the last item)
+    // into at most parts partitions. Going down from the root, each level keeps only the subtrees
+    // that can hold items in range, until there are at least 4 per partition; the partitions
+    // split them evenly. In thread-safe mode every node is read under its shared latch, and the
+    // partitions stay correct under concurrent inserts: a leaf split keeps both halves before the
+    // next partition's first leaf, which is the leftmost leaf of a subtree and never changes.
+    std::vector<ScanPartition> scan_partitions(const T* start, const T* end, std::size_t parts){
+        std::vector<ScanPartition> result;
+        if(this->thread_safe){
+            this->root_latch.lock_shared();
+        }
+        Node<T, Fanout, Aggregate>* root = this->root;
+        if(this->thread_safe){
+            this->root_latch.unlock_shared();
+        }
+        if(root == nullptr){
+            return result;
+        }
+        std::vector<Node<T, Fanout, Aggregate>*> level(1, root);
+        while(!level[0]->is_leaf && level.size() < 4 * parts){
+            std::vector<Node<T, Fanout, Aggregate>*> below;
+            for(std::size_t n=0; n<level.size(); n++){
+                Node<T, Fanout, Aggregate>* node = level[n];
+                if(this->thread_safe){
+                    node->latch.lock_shared();
                 }
-                for(int i=0; i<cursor->size+1;i++){
-                    leftsibling->children[leftsibling->size+i+1] = cursor->children[i];
-                    cursor->children[i]->parent = leftsibling;
+                //subtrees before start hold nothing to scan, nor do those after the first key past end
+                int first = (n == 0 && start != nullptr) ? node_rank<false>(node, *start) : 0;
+                int last = (n + 1 == level.size() && end != nullptr) ? leaf_stop(node, 0, *end) : node->size;
+                for(int c=first; c<=last; c++){
+                    below.push_back(node->children[c]);
                 }
-                for(int i=0; i<cursor->size+1; i++){
-                    cursor->children[i] = nullptr;
+                if(this->thread_safe){
+                    node->latch.unlock_shared();
                 }
-                leftsibling->size = leftsibling->size+cursor->size+1;
-                //delete recursion
-                Removepar(cursor, left,cursor->parent);
-                return;
+            }
+            if(below.empty()){ //end is before start
+                return result;
+            }
+            level.swap(below);
+        }
 
+        parts = std::min(parts, level.size());
+        std::vector<Node<T, Fanout, Aggregate>*> first_leaf(parts + 1, nullptr);
+        std::size_t next = 0;
+        for(std::size_t p=0; p<parts; p++){
+            if(p > 0 || start == nullptr){
+                first_leaf[p] = leftmost_leaf(level[next]);
+            }
+            next += level.size() / parts + (p < level.size() % parts ? 1 : 0);
+        }
+        for(std::size_t p=0; p<parts; p++){
+            result.push_back({first_leaf[p], first_leaf[p+1]});
+        }
+        return result;
+    }
+    Node<T, Fanout, Aggregate>* leftmost_leaf(Node<T, Fanout, Aggregate>* cursor){
+        while(!cursor->is_leaf){
+            if(this->thread_safe){
+                cursor->latch.lock_shared();
             }
-            if(right<=cursor->parent->size){ // right_sibiling exists
-                Node<T>* rightsibling = cursor->parent->children[right];
+            Node<T, Fanout, Aggregate>* child = cursor->children[0];
+            if(this->thread_safe){
+                cursor->latch.unlock_shared();
+            }
+            cursor = child;
+        }
+        return cursor;
+    }
 
-                cursor->item[cursor->size] = cursor->parent->item[right-1];
-                //merge two leaf node
-                for(int i=0; i<rightsibling->size; i++){
-                    cursor->item[cursor->size+1+i]=rightsibling->item[i];
+    // Call f on the items of part (those whose column value is in *filter, if given), stopping
+    // early at the first item past *end. Leaves are latched hand over hand, as in walk_leaf_chain;
+    // if f throws, the latch held is let go before the exception moves on.
+    template<typename Func>
+    void scan_partition(const ScanPartition& part, const T* start, const T* end, const column_range* filter, Func&& f){
+        Node<T, Fanout, Aggregate>* leaf = part.leaf;
+        int index = 0;
+        if(leaf == nullptr){
+            leaf = find_leaf(start);
+            index = leaf != nullptr ? node_rank<false>(leaf, *start) : 0;
+        }
+        else if(this->thread_safe){
+            leaf->latch.lock_shared();
+        }
+        try{
+            while(leaf != nullptr && leaf != part.stop){
+                int stop = end != nullptr ? leaf_stop(leaf, index, *end) : leaf->size;
+                bool filtered = false;
+                if constexpr (columnar) {
+                    filtered = filter != nullptr;
+                    if(filtered){
+                        select_leaf(leaf, index, stop, *filter, [&](T& item){
+                            f(item);
+                            return true;
+                        });
+                    }
                 }
-                for(int i=0; i<rightsibling->size+1;i++){
-                    cursor->children[cursor->size+i+1] = rightsibling->children[i];
-                    rightsibling->children[i]->parent=rightsibling;
+                if(!filtered){
+                    for(int i=index; i<stop; i++){
+                        if(leaf->tombstones != 0 && leaf->dead[i]){
+                            continue;
+                        }
+                        f(leaf->item[i]);
+                    }
                 }
-                for(int i=0; i<rightsibling->size+1; i++){
-                    rightsibling->children[i] = nullptr;
+                if(stop < leaf->size){
+                    break;
                 }
-                //edit pointer
-                rightsibling->size = rightsibling->size+cursor->size+1;
-                //parent property edit
-                Removepar(rightsibling, right-1,cursor->parent);
-                return;
+                Node<T, Fanout, Aggregate>* next = leaf->children[leaf->size];
+                if(this->thread_safe){
+                    if(next != nullptr){
+                        next->latch.lock_shared();
+                    }
+                    leaf->latch.unlock_shared();
+                }
+                leaf = next;
+                index = 0;
             }
         }
-        else{
-            return;
+        catch(...){
+            if(this->thread_safe && leaf != nullptr){
+                leaf->latch.unlock_shared();
+            }
+            throw;
+        }
+        if(this->thread_safe && leaf != nullptr){
+            leaf->latch.unlock_shared();
         }
     }
 
-    // Método para recorrer todos los elementos hoja y aplicar una función
-    template<typename Func>
-    void for_each(Func f) {
-        if (!root) return;
-        // Buscar la hoja más a la izquierda
-        Node<T>* cursor = root;
-        while (!cursor->is_leaf) {
-            cursor = cursor->children[0];
+    // Run job(0) .. job(count-1) on this thread and the shared worker pool of Parallel.h, and
+    // return the first exception a job threw, if any, once all of them have finished.
+    template<typename Job>
+    static std::exception_ptr run_partitions(std::size_t count, Job job){
+        try{
+            parallel_run(count, job);
         }
-        // Recorrer todas las hojas
-        while (cursor) {
-            for (int i = 0; i < cursor->size; ++i) {
-                f(cursor->item[i]); // Cambia a pasar referencia
+        catch(...){
+            return std::current_exception();
+        }
+        return nullptr;
+    }
+
+    std::size_t height(){
+        read_lock();
+        std::size_t levels = 0;
+        for(Node<T, Fanout, Aggregate>* cursor = this->root; cursor != nullptr; cursor = cursor->is_leaf ? nullptr : cursor->children[0]){
+            levels++;
+        }
+        read_unlock();
+        return levels;
+    }
+    // Walks every node, so it takes the tree exclusively.
+    BPlusTreeStats stats(){
+        write_lock();
+        BPlusTreeStats result;
+        result.degree = this->degree;
+        collect_stats(this->root, 1, result);
+        result.node_bytes = this->arena.bytes_reserved();
+        result.used_node_bytes = (result.leaves + result.internal_nodes) * Node<T, Fanout, Aggregate>::block_size(this->degree);
+        write_unlock();
+        return result;
+    }
+    void collect_stats(Node<T, Fanout, Aggregate>* cursor, std::size_t depth, BPlusTreeStats& result){
+        if(cursor == nullptr){
+            return;
+        }
+        result.height = std::max(result.height, depth);
+        if(result.level_nodes.size() < depth){
+            result.level_nodes.resize(depth);
+        }
+        result.level_nodes[depth-1]++;
+        if(cursor->is_leaf){
+            result.leaves++;
+            result.items += cursor->size - cursor->tombstones;
+            result.tombstones += cursor->tombstones;
+            std::size_t bucket = (cursor->size - cursor->tombstones) * result.leaf_fill.size() / (this->degree - 1);
+            result.leaf_fill[std::min(bucket, result.leaf_fill.size() - 1)]++;
+            for(int i=0; i<cursor->size; i++){
+                result.leaf_key_bytes += bptree_heap_bytes(cursor->item[i]); // tombstoned items too, they still hold it
             }
-            cursor = cursor->children[cursor->size];
+            return;
+        }
+        result.internal_nodes++;
+        for(int i=0; i<cursor->size; i++){
+            result.separator_bytes += bptree_heap_bytes(cursor->item[i]);
+        }
+        for(int i=0; i<=cursor->size; i++){
+            collect_stats(cursor->children[i], depth + 1, result);
+        }
+    }
+
+    BPlusTreeCounters counters() const {
+        BPlusTreeCounters result;
+#ifdef BPLUSTREE_COUNTERS
+        result.enabled = true;
+        result.inserts = this->hot_counters.inserts.load(std::memory_order_relaxed);
+        result.removes = this->hot_counters.removes.load(std::memory_order_relaxed);
+        result.lookups = this->hot_counters.lookups.load(std::memory_order_relaxed);
+        result.comparisons = this->hot_counters.comparisons.load(std::memory_order_relaxed);
+        result.node_visits = this->hot_counters.node_visits.load(std::memory_order_relaxed);
+        result.splits = this->hot_counters.splits.load(std::memory_order_relaxed);
+        result.merges = this->hot_counters.merges.load(std::memory_order_relaxed);
+        result.borrows = this->hot_counters.borrows.load(std::memory_order_relaxed);
+#endif
+        return result;
+    }
+    void reset_counters(){
+#ifdef BPLUSTREE_COUNTERS
+        for(auto* counter : {&this->hot_counters.inserts, &this->hot_counters.removes, &this->hot_counters.lookups,
+                             &this->hot_counters.comparisons, &this->hot_counters.node_visits, &this->hot_counters.splits,
+                             &this->hot_counters.merges, &this->hot_counters.borrows}){
+            counter->store(0, std::memory_order_relaxed);
         }
+#endif
+    }
+
+    // {"stats": ..., "counters": ...} on one line.
+    void write_json(std::ostream& out){
+        out << "{\"stats\": ";
+        bptree_write_json(out, stats());
+        out << ", \"counters\": ";
+        bptree_write_json(out, counters());
+        out << "}";
     }
 
+    // Drop every item. All nodes go back with the arena's slabs in one step; the tree is only
+    // walked when the keys have destructors to run.
+    void clear(){
+        write_lock();
+        release_all();
+        write_unlock();
+    }
+    void release_all(){
+        if(!std::is_trivially_destructible<T>::value){
+            clear(this->root);
+        }
+        this->arena.release();
+        this->root = nullptr;
+        this->tombstone_count = 0;
+        this->frees++;
+    }
 
-    void clear(Node<T>* cursor){
+    void clear(Node<T, Fanout, Aggregate>* cursor){
         if(cursor != nullptr){
             if(!cursor->is_leaf){
                 for(int i=0; i <= cursor->size; i++){
                     clear(cursor->children[i]);
                 }
             }
-            delete[] cursor->item;
-            delete[] cursor->children;
-            delete cursor;
+            free_node(cursor);
         }
     }
     void bpt_print(){
         print(this->root);
     }
-    void print(Node<T>* cursor) {
+    void print(Node<T, Fanout, Aggregate>* cursor) {
         // You must NOT edit this function.
         if (cursor != NULL) {
             for (int i = 0; i < cursor->size; ++i) {
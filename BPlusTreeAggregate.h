@@ -0,0 +1,54 @@
+#ifndef BPlusTreeAggregate_H
+#define BPlusTreeAggregate_H
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+// Monoids for an augmented BPlusTree<T, Fanout, Aggregate>. An Aggregate provides
+//   value_type, identity(), of(item) and combine(a, b)
+// with combine associative and commutative: inserts fold the new item into every node on
+// its path without knowing where it lands. Augmented nodes also keep their item count, which
+// rank, select and range_count use whatever the Aggregate is.
+
+// Nothing beyond the count: for trees that only need rank, select and range_count.
+template <typename T>
+struct BPlusTreeCount {
+    using value_type = std::size_t;
+    static value_type identity() { return 0; }
+    static value_type of(const T&) { return 1; }
+    static value_type combine(value_type a, value_type b) { return a + b; }
+};
+
+// Sum of a member, e.g. BPlusTreeSum<Valoracion, uint16_t, &Valoracion::medias>.
+// Floating point members are added up in double.
+template <typename T, typename V, V T::*Member>
+struct BPlusTreeSum {
+    using value_type = typename std::conditional<std::is_floating_point<V>::value, double, V>::type;
+    static value_type identity() { return value_type(); }
+    static value_type of(const T& item) { return item.*Member; }
+    static value_type combine(value_type a, value_type b) { return a + b; }
+};
+
+// Smallest and largest value of a member; empty for an empty range.
+template <typename T, typename V, V T::*Member>
+struct BPlusTreeMinMax {
+    struct value_type {
+        V min;
+        V max;
+        bool empty;
+    };
+    static value_type identity() { return {V(), V(), true}; }
+    static value_type of(const T& item) { return {item.*Member, item.*Member, false}; }
+    static value_type combine(const value_type& a, const value_type& b) {
+        if(a.empty){
+            return b;
+        }
+        if(b.empty){
+            return a;
+        }
+        return {std::min(a.min, b.min), std::max(a.max, b.max), false};
+    }
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef BPlusTreeKey_H
+#define BPlusTreeKey_H
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Per-key-type hooks for BPlusTree. Specializations may provide:
+//   normalized / normalize(key)  a fixed-width integer with the same ordering, which unlocks
+//                                the branchless node search (required member)
+//   separator(left, right)       the shortest key s with left < s <= right, stored in internal
+//                                nodes instead of a full copy of right (optional)
+//   heap_bytes(key)              heap memory owned by a key, for stats() (optional)
+//   column(key)                  a float or 32-bit integer field of the key (say, a rating's
+//                                value) that leaves also keep in an array of their own, so
+//                                filtered scans compare it four at a time (optional)
+template <typename T, typename = void>
+struct BPlusTreeKey {
+    static constexpr bool normalized = false;
+};
+
+template <typename T>
+struct BPlusTreeKey<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+    static constexpr bool normalized = true;
+    static T normalize(T key) { return key; }
+};
+
+template <typename Key, typename T, typename = void>
+struct bptree_has_separator : std::false_type {};
+template <typename Key, typename T>
+struct bptree_has_separator<Key, T, decltype(void(Key::separator(std::declval<const T&>(), std::declval<const T&>())))>
+    : std::true_type {};
+
+template <typename Key, typename T, typename = void>
+struct bptree_has_heap_bytes : std::false_type {};
+template <typename Key, typename T>
+struct bptree_has_heap_bytes<Key, T, decltype(void(Key::heap_bytes(std::declval<const T&>())))>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct bptree_column {
+    using type = void;
+};
+template <typename T>
+struct bptree_column<T, decltype(void(BPlusTreeKey<T>::column(std::declval<const T&>())))> {
+    using type = typename std::decay<decltype(BPlusTreeKey<T>::column(std::declval<const T&>()))>::type;
+    static_assert(std::is_same<type, float>::value || (std::is_integral<type>::value && sizeof(type) == 4),
+                  "a leaf column holds floats or 32-bit integers");
+};
+
+// Filter of the columnar scans: the items whose column value c has lo <= c <= hi.
+template <typename C>
+struct BPlusTreeColumnRange {
+    C lo;
+    C hi;
+};
+
+template <>
+struct BPlusTreeColumnRange<void> { // keys without a column
+};
+
+// Separator between two neighbouring nodes whose items end with left and start with right.
+// Equal keys can straddle a split, and then the only separator is right itself.
+template <typename T>
+T bptree_separator(const T& left, const T& right) {
+    if constexpr (bptree_has_separator<BPlusTreeKey<T>, T>::value) {
+        if(left < right){
+            return BPlusTreeKey<T>::separator(left, right);
+        }
+    }
+    return right;
+}
+
+template <typename T>
+std::size_t bptree_heap_bytes(const T& key) {
+    if constexpr (bptree_has_heap_bytes<BPlusTreeKey<T>, T>::value) {
+        return BPlusTreeKey<T>::heap_bytes(key);
+    }
+    else {
+        return 0;
+    }
+}
+
+// Shortest prefix of right that is greater than left (left < right).
+inline std::string bptree_string_separator(const std::string& left, const std::string& right) {
+    std::size_t common = 0;
+    while(common < left.size() && left[common] == right[common]){
+        common++;
+    }
+    return right.substr(0, common + 1);
+}
+
+// Bytes a string keeps on the heap; zero while it fits in the small-string buffer.
+inline std::size_t bptree_string_heap_bytes(const std::string& s) {
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+// String keys (codes such as "U000123") route with the shortest prefix that separates two
+// nodes. Leaves keep whole strings: for_each and range_for_each hand out T& into them, so
+// leaf prefix compression is not done.
+template <>
+struct BPlusTreeKey<std::string> {
+    static constexpr bool normalized = false;
+
+    static std::string separator(const std::string& left, const std::string& right) {
+        return bptree_string_separator(left, right);
+    }
+    static std::size_t heap_bytes(const std::string& key) {
+        return bptree_string_heap_bytes(key);
+    }
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef BPlusTreeStats_H
+#define BPlusTreeStats_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Shape and memory use of a tree, from BPlusTree::stats().
+struct BPlusTreeStats {
+    std::size_t degree = 0;
+    std::size_t height = 0;
+    std::size_t leaves = 0;
+    std::size_t internal_nodes = 0;
+    std::size_t items = 0;      // live items
+    std::size_t tombstones = 0; // deleted items still taking up leaf slots
+    std::vector<std::size_t> level_nodes;   // nodes on each level, root first
+    std::array<std::size_t, 10> leaf_fill {}; // leaves by live fill in tenths of capacity, full ones last
+    std::size_t node_bytes = 0;      // arena slabs holding the nodes
+    std::size_t used_node_bytes = 0; // node blocks in use by the tree
+    std::size_t leaf_key_bytes = 0;  // heap owned by the items in the leaves
+    std::size_t separator_bytes = 0; // heap owned by the separators in internal nodes
+};
+
+// Work done by a tree, from BPlusTree::counters(). They are only kept when the tree is built
+// with -DBPLUSTREE_COUNTERS and read zero otherwise; take differences around an operation to
+// see what it cost.
+struct BPlusTreeCounters {
+    bool enabled = false;
+    std::uint64_t inserts = 0;     // items inserted, one by one or in batches
+    std::uint64_t removes = 0;
+    std::uint64_t lookups = 0;     // searches, range scans and lower/upper bounds
+    std::uint64_t comparisons = 0; // key comparisons searching nodes and scanning leaves
+    std::uint64_t node_visits = 0;
+    std::uint64_t splits = 0;
+    std::uint64_t merges = 0;
+    std::uint64_t borrows = 0;
+};
+
+inline void bptree_write_json(std::ostream& out, const BPlusTreeStats& stats) {
+    out << "{\"degree\": " << stats.degree
+        << ", \"height\": " << stats.height
+        << ", \"leaves\": " << stats.leaves
+        << ", \"internal_nodes\": " << stats.internal_nodes
+        << ", \"items\": " << stats.items
+        << ", \"tombstones\": " << stats.tombstones
+        << ", \"level_nodes\": [";
+    for(std::size_t i=0; i<stats.level_nodes.size(); i++){
+        out << (i ? ", " : "") << stats.level_nodes[i];
+    }
+    out << "], \"leaf_fill\": [";
+    for(std::size_t i=0; i<stats.leaf_fill.size(); i++){
+        out << (i ? ", " : "") << stats.leaf_fill[i];
+    }
+    out << "], \"node_bytes\": " << stats.node_bytes
+        << ", \"used_node_bytes\": " << stats.used_node_bytes
+        << ", \"leaf_key_bytes\": " << stats.leaf_key_bytes
+        << ", \"separator_bytes\": " << stats.separator_bytes << "}";
+}
+
+inline void bptree_write_json(std::ostream& out, const BPlusTreeCounters& counters) {
+    out << "{\"enabled\": " << (counters.enabled ? "true" : "false")
+        << ", \"inserts\": " << counters.inserts
+        << ", \"removes\": " << counters.removes
+        << ", \"lookups\": " << counters.lookups
+        << ", \"comparisons\": " << counters.comparisons
+        << ", \"node_visits\": " << counters.node_visits
+        << ", \"splits\": " << counters.splits
+        << ", \"merges\": " << counters.merges
+        << ", \"borrows\": " << counters.borrows << "}";
+}
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef BufferPool_H
+#define BufferPool_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Caches fixed-size pages of a file in a fixed number of frames (memory_budget / page_size).
+// Pages are pinned while in use; unpinned pages are evicted with the clock algorithm and
+// written back if dirty. Pages marked resident are never evicted (hot upper tree levels).
+class BufferPool {
+public:
+    static constexpr std::uint32_t NO_PAGE = 0xffffffffu;
+
+private:
+    struct Frame {
+        std::uint32_t page = NO_PAGE;
+        int pins = 0;
+        bool dirty = false;
+        bool referenced = false;
+        bool resident = false;
+    };
+
+    int fd;
+    std::size_t page_size;
+    std::vector<char> memory; // frame i is memory[i*page_size, (i+1)*page_size)
+    std::vector<Frame> frames;
+    std::unordered_map<std::uint32_t, std::size_t> table; // page -> frame
+    std::size_t hand; // clock hand
+    std::size_t resident_count;
+    std::uint32_t page_count; // pages in the file, including ones not written yet
+
+    char* frame_data(std::size_t frame) {
+        return this->memory.data() + frame * this->page_size;
+    }
+
+    void write_back(std::size_t frame) {
+        Frame& f = this->frames[frame];
+        if(f.dirty){
+            off_t offset = static_cast<off_t>(f.page) * this->page_size;
+            if(pwrite(this->fd, frame_data(frame), this->page_size, offset) != static_cast<ssize_t>(this->page_size)){
+                throw std::runtime_error("BufferPool: page write failed");
+            }
+            f.dirty = false;
+        }
+    }
+
+    // Free frame for a new page, evicting an unpinned page if needed.
+    std::size_t victim() {
+        for(std::size_t step=0; step < 2 * this->frames.size() + 1; step++){
+            std::size_t frame = this->hand;
+            this->hand = (this->hand + 1) % this->frames.size();
+            Frame& f = this->frames[frame];
+            if(f.page == NO_PAGE){
+                return frame;
+            }
+            if(f.pins > 0 || f.resident){
+                continue;
+            }
+            if(f.referenced){ //second chance
+                f.referenced = false;
+                continue;
+            }
+            write_back(frame);
+            this->table.erase(f.page);
+            f.page = NO_PAGE;
+            return frame;
+        }
+        throw std::runtime_error("BufferPool: every frame is pinned");
+    }
+
+    // The frame is only claimed once the page is in it: a failed read leaves it free.
+    char* load(std::uint32_t page, bool read) {
+        std::size_t frame = victim();
+        char* data = frame_data(frame);
+        if(read){
+            off_t offset = static_cast<off_t>(page) * this->page_size;
+            ssize_t got = pread(this->fd, data, this->page_size, offset);
+            if(got < 0){
+                throw std::runtime_error("BufferPool: page read failed");
+            }
+            std::memset(data + got, 0, this->page_size - got); //past the end of the file
+        }
+        else{
+            std::memset(data, 0, this->page_size);
+        }
+        Frame& f = this->frames[frame];
+        f.page = page;
+        f.pins = 1;
+        f.dirty = !read;
+        f.referenced = true;
+        f.resident = false;
+        this->table[page] = frame;
+        return data;
+    }
+
+public:
+    BufferPool(const std::string& path, std::size_t _page_size, std::size_t memory_budget) {// Constructor
+        this->page_size = _page_size;
+        std::size_t frame_count = memory_budget / _page_size;
+        if(frame_count < 16){
+            frame_count = 16;
+        }
+        this->memory.resize(frame_count * _page_size);
+        this->frames.resize(frame_count);
+        this->hand = 0;
+        this->resident_count = 0;
+
+        this->fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        this->page_count = 0;
+        if(this->fd >= 0){
+            off_t bytes = lseek(this->fd, 0, SEEK_END);
+            this->page_count = static_cast<std::uint32_t>((bytes + _page_size - 1) / _page_size);
+        }
+    }
+    ~BufferPool() {
+        close();
+    }
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    bool is_open() const {
+        return this->fd >= 0;
+    }
+    std::uint32_t pages() const {
+        return this->page_count;
+    }
+    std::size_t frame_count() const {
+        return this->frames.size();
+    }
+
+    // Bytes of the page, valid until the matching unpin.
+    char* pin(std::uint32_t page) {
+        auto found = this->table.find(page);
+        if(found != this->table.end()){
+            Frame& f = this->frames[found->second];
+            f.pins++;
+            f.referenced = true;
+            return frame_data(found->second);
+        }
+        return load(page, true);
+    }
+    void unpin(std::uint32_t page, bool dirty) {
+        Frame& f = this->frames[this->table.at(page)];
+        f.pins--;
+        f.dirty = f.dirty || dirty;
+    }
+
+    // Append a zeroed page to the file and pin it.
+    std::uint32_t allocate(char** data) {
+        std::uint32_t page = this->page_count;
+        *data = load(page, false);
+        this->page_count++;
+        return page;
+    }
+
+    // Never evict page once it is cached. Capped at half the frames so the pool can't clog.
+    void keep_resident(std::uint32_t page) {
+        auto found = this->table.find(page);
+        if(found == this->table.end() || this->resident_count >= this->frames.size() / 2){
+            return;
+        }
+        Frame& f = this->frames[found->second];
+        if(!f.resident){
+            f.resident = true;
+            this->resident_count++;
+        }
+    }
+
+    // Drop every page from keep_pages on, cached or not. None of them may be pinned.
+    void truncate(std::uint32_t keep_pages) {
+        for(Frame& f : this->frames){
+            if(f.page != NO_PAGE && f.page >= keep_pages){
+                this->table.erase(f.page);
+                this->resident_count -= f.resident ? 1 : 0;
+                f = Frame();
+            }
+        }
+        if(ftruncate(this->fd, static_cast<off_t>(keep_pages) * this->page_size) != 0){
+            throw std::runtime_error("BufferPool: truncate failed");
+        }
+        this->page_count = keep_pages;
+    }
+
+    void flush() {
+        for(std::size_t frame=0; frame<this->frames.size(); frame++){
+            if(this->frames[frame].page != NO_PAGE){
+                write_back(frame);
+            }
+        }
+    }
+
+    // Write the dirty pages back and close the file. Returns false if a page could not be
+    // written or the file could not be closed; the pool is closed either way. The destructor
+    // calls it too, but can't report the error, so call it first when it matters.
+    bool close() {
+        if(this->fd < 0){
+            return true;
+        }
+        bool written = true;
+        try{
+            flush();
+        }
+        catch(const std::runtime_error&){
+            written = false;
+        }
+        written = ::close(this->fd) == 0 && written;
+        this->fd = -1;
+        return written;
+    }
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef NodeArena_H
+#define NodeArena_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Hands out fixed-size blocks carved from large slabs. Freed blocks go to a free list and
+// are reused by the next allocation; release() gives every slab back at once.
+class NodeArena {
+    std::size_t block_size;
+    std::size_t slab_blocks; // blocks per slab
+    std::vector<char*> slabs;
+    char* next; // next unused block in the newest slab
+    char* slab_end;
+    void* free_list;
+
+public:
+    NodeArena(std::size_t _block_size, std::size_t slab_bytes = 1 << 20) {// Constructor
+        const std::size_t align = alignof(std::max_align_t);
+        this->block_size = (_block_size + align - 1) / align * align;
+        this->slab_blocks = slab_bytes / this->block_size;
+        if(this->slab_blocks < 16){
+            this->slab_blocks = 16;
+        }
+        this->next = nullptr;
+        this->slab_end = nullptr;
+        this->free_list = nullptr;
+    }
+    ~NodeArena() {
+        release();
+    }
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    void* allocate() {
+        if(this->free_list != nullptr){ // reuse a freed block first
+            void* block = this->free_list;
+            this->free_list = *static_cast<void**>(block);
+            return block;
+        }
+        if(this->next == this->slab_end){
+            char* slab = static_cast<char*>(::operator new(this->slab_blocks * this->block_size));
+            this->slabs.push_back(slab);
+            this->next = slab;
+            this->slab_end = slab + this->slab_blocks * this->block_size;
+        }
+        void* block = this->next;
+        this->next += this->block_size;
+        return block;
+    }
+
+    void deallocate(void* block) {
+        *static_cast<void**>(block) = this->free_list;
+        this->free_list = block;
+    }
+
+    // Free every block at once. Objects living in the blocks are not destroyed.
+    void release() {
+        for(char* slab : this->slabs){
+            ::operator delete(slab);
+        }
+        this->slabs.clear();
+        this->next = nullptr;
+        this->slab_end = nullptr;
+        this->free_list = nullptr;
+    }
+
+    std::size_t bytes_reserved() const {
+        return this->slabs.size() * this->slab_blocks * this->block_size;
+    }
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef NodeLatch_H
+#define NodeLatch_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Reader/writer latch small enough to live in every node. Readers share it; a writer that
+// is waiting stops new readers from coming in, so inserts are not starved by long scans.
+class NodeLatch {
+    static constexpr std::uint32_t WRITER = 1u << 31;
+    static constexpr std::uint32_t WAITING = 1u << 30;
+    std::atomic<std::uint32_t> state; // WRITER | WAITING | number of readers
+
+public:
+    NodeLatch() : state(0) {}
+    NodeLatch(const NodeLatch&) = delete;
+    NodeLatch& operator=(const NodeLatch&) = delete;
+
+    void lock_shared() {
+        for(;;){
+            std::uint32_t s = this->state.load(std::memory_order_relaxed);
+            if((s & (WRITER | WAITING)) == 0 &&
+               this->state.compare_exchange_weak(s, s + 1, std::memory_order_acquire)){
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+    void unlock_shared() {
+        this->state.fetch_sub(1, std::memory_order_release);
+    }
+
+    void lock() {
+        for(;;){
+            std::uint32_t s = this->state.load(std::memory_order_relaxed);
+            if((s & ~WAITING) == 0){
+                if(this->state.compare_exchange_weak(s, WRITER, std::memory_order_acquire)){
+                    return;
+                }
+            }
+            else if((s & WAITING) == 0){
+                this->state.fetch_or(WAITING, std::memory_order_relaxed);
+            }
+            std::this_thread::yield();
+        }
+    }
+    void unlock() {
+        this->state.store(0, std::memory_order_release);
+    }
+};
+
+#endif
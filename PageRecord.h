@@ -0,0 +1,27 @@
+#ifndef PageRecord_H
+#define PageRecord_H
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Fixed-width encoding of a record inside a page of PagedBPlusTree.
+// Trivially copyable types are stored as their bytes; other types specialize it.
+template <typename T, typename = void>
+struct PageRecord;
+
+template <typename T>
+struct PageRecord<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+    static constexpr std::size_t size = sizeof(T);
+
+    static void encode(const T& value, char* out) {
+        std::memcpy(out, &value, sizeof(T));
+    }
+    static T decode(const char* in) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        return value;
+    }
+};
+
+#endif
@@ -0,0 +1,712 @@
+#ifndef PagedBPlusTree_H
+#define PagedBPlusTree_H
+
+#include "BPlusTreeKey.h"
+#include "BufferPool.h"
+#include "PageRecord.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// B+ tree whose nodes are fixed-size pages of a file, addressed by page id. Only the pages held
+// by the buffer pool are in memory, so the index can be far larger than RAM. Records go through
+// PageRecord<T>; keys are decoded while searching, so callers always see plain T values.
+//
+// Page 0 holds the MetaPage. A node page is a PageHeader followed by
+//   leaf:     records[leaf_cap]
+//   internal: children[inner_cap+1] (page ids), keys[inner_cap]
+// and a leaf's next field is the page id of the leaf on its right.
+//
+// Same ordering rules as BPlusTree, and single threaded. remove borrows from or merges with a
+// sibling when a page drops under half full, like BPlusTree. Pages it frees are chained through
+// their next field into a free list (head in the MetaPage), and new pages come from it first, so
+// the file stops growing after deletes; it only shrinks when bulk_load rewrites it.
+template <typename T>
+class PagedBPlusTree {
+    using Record = PageRecord<T>;
+    using PageId = std::uint32_t;
+    static constexpr PageId NO_PAGE = BufferPool::NO_PAGE;
+    static constexpr std::uint32_t MAGIC = 0x54504252; // "RBPT"
+
+    struct PageHeader {
+        std::uint32_t is_leaf;
+        std::uint32_t size; // records in a leaf, keys in an internal node
+        PageId next;
+        std::uint32_t unused;
+    };
+    struct MetaPage {
+        std::uint32_t magic;
+        std::uint32_t page_size;
+        std::uint32_t record_size;
+        PageId root;
+        std::uint32_t height;
+        PageId free_list; // first free page; 0 (the meta page) when there is none
+        std::uint64_t count;
+    };
+
+    // A pinned page; it is unpinned (and written back later if touched) when it goes away.
+    class Page {
+        BufferPool* pool;
+        PageId id;
+        char* bytes;
+        bool dirty;
+
+    public:
+        Page() : pool(nullptr), id(NO_PAGE), bytes(nullptr), dirty(false) {}
+        Page(BufferPool* _pool, PageId _id, char* _bytes) : pool(_pool), id(_id), bytes(_bytes), dirty(false) {}
+        Page(Page&& other) noexcept : pool(other.pool), id(other.id), bytes(other.bytes), dirty(other.dirty) {
+            other.pool = nullptr;
+        }
+        Page& operator=(Page&& other) noexcept {
+            if(this != &other){
+                release();
+                this->pool = other.pool;
+                this->id = other.id;
+                this->bytes = other.bytes;
+                this->dirty = other.dirty;
+                other.pool = nullptr;
+            }
+            return *this;
+        }
+        ~Page() {
+            release();
+        }
+        void release() {
+            if(this->pool != nullptr){
+                this->pool->unpin(this->id, this->dirty);
+                this->pool = nullptr;
+                this->bytes = nullptr;
+            }
+        }
+
+        bool valid() const {
+            return this->bytes != nullptr;
+        }
+        PageId page_id() const {
+            return this->id;
+        }
+        char* data() {
+            return this->bytes;
+        }
+        PageHeader& header() {
+            return *reinterpret_cast<PageHeader*>(this->bytes);
+        }
+        void touch() {
+            this->dirty = true;
+        }
+    };
+
+    BufferPool pool;
+    std::size_t page_size;
+    std::size_t leaf_cap;  // records per leaf
+    std::size_t inner_cap; // keys per internal node
+    std::uint32_t hot_levels; // levels from the root kept resident in the pool
+    PageId root;
+    std::uint32_t levels;
+    std::uint64_t count;
+    PageId free_list;
+    bool opened;
+
+public:
+    // Open the index stored at path, or create it if the file is empty. At most memory_budget
+    // bytes of pages are cached. Check is_open(): it is false if the file can't be opened or was
+    // written with another page size or record type.
+    PagedBPlusTree(const std::string& path, std::size_t memory_budget = 64 << 20, std::size_t _page_size = 4096,
+                   std::uint32_t _hot_levels = 2)
+        : pool(path, _page_size, memory_budget) {// Constructor
+        this->page_size = _page_size;
+        this->leaf_cap = (_page_size - sizeof(PageHeader)) / Record::size;
+        this->inner_cap = (_page_size - sizeof(PageHeader) - sizeof(PageId)) / (Record::size + sizeof(PageId));
+        this->hot_levels = _hot_levels;
+        this->root = NO_PAGE;
+        this->levels = 0;
+        this->count = 0;
+        this->free_list = 0;
+        this->opened = false;
+        if(!this->pool.is_open() || _page_size < sizeof(MetaPage) || this->leaf_cap < 2 || this->inner_cap < 2){
+            return;
+        }
+
+        if(this->pool.pages() == 0){ //new file
+            char* bytes = nullptr;
+            Page meta(&this->pool, this->pool.allocate(&bytes), bytes);
+            meta.release();
+            this->opened = true;
+            write_meta();
+            return;
+        }
+        Page meta = fetch(0, 0);
+        MetaPage m;
+        std::memcpy(&m, meta.data(), sizeof(m));
+        if(m.magic != MAGIC || m.page_size != _page_size || m.record_size != Record::size){
+            return;
+        }
+        this->root = m.root;
+        this->levels = m.height;
+        this->count = m.count;
+        this->free_list = m.free_list;
+        this->opened = true;
+    }
+    ~PagedBPlusTree() {
+        close();
+    }
+    PagedBPlusTree(const PagedBPlusTree&) = delete;
+    PagedBPlusTree& operator=(const PagedBPlusTree&) = delete;
+
+    bool is_open() const {
+        return this->opened;
+    }
+    std::uint64_t size() const {
+        return this->count;
+    }
+    std::uint32_t height() const {
+        return this->levels;
+    }
+    // Write every dirty page and the meta page to the file.
+    void flush() {
+        write_meta();
+        this->pool.flush();
+    }
+    // Flush and close the file; the tree can't be used afterwards. Returns false if the pages
+    // could not all be written. The destructor closes too, but drops the error.
+    bool close() {
+        if(!this->opened){
+            return this->pool.close();
+        }
+        this->opened = false;
+        bool written = true;
+        try{
+            write_meta();
+        }
+        catch(const std::runtime_error&){
+            written = false;
+        }
+        return this->pool.close() && written;
+    }
+
+private:
+    void write_meta() {
+        MetaPage m{MAGIC, static_cast<std::uint32_t>(this->page_size), static_cast<std::uint32_t>(Record::size),
+                   this->root, this->levels, this->free_list, this->count};
+        Page meta = fetch(0, 0);
+        std::memcpy(meta.data(), &m, sizeof(m));
+        meta.touch();
+    }
+
+    // Pin page id, found at depth levels below the root.
+    Page fetch(PageId id, std::uint32_t depth) {
+        Page page(&this->pool, id, this->pool.pin(id));
+        if(depth < this->hot_levels){
+            this->pool.keep_resident(id);
+        }
+        return page;
+    }
+    // A page from the free list, or a new one at the end of the file.
+    Page new_page(bool leaf) {
+        Page page;
+        if(this->free_list != 0){
+            page = Page(&this->pool, this->free_list, this->pool.pin(this->free_list));
+            this->free_list = page.header().next;
+        }
+        else{
+            char* bytes = nullptr;
+            PageId id = this->pool.allocate(&bytes);
+            page = Page(&this->pool, id, bytes);
+        }
+        page.touch();
+        page.header().is_leaf = leaf;
+        page.header().size = 0;
+        page.header().next = NO_PAGE;
+        return page;
+    }
+
+    void free_page(Page& page) {
+        page.header().is_leaf = false;
+        page.header().size = 0;
+        page.header().next = this->free_list;
+        page.touch();
+        this->free_list = page.page_id();
+        page.release();
+    }
+
+    char* records(Page& leaf) {
+        return leaf.data() + sizeof(PageHeader);
+    }
+    PageId* children(Page& node) {
+        return reinterpret_cast<PageId*>(node.data() + sizeof(PageHeader));
+    }
+    char* keys(Page& node) {
+        return node.data() + sizeof(PageHeader) + (this->inner_cap + 1) * sizeof(PageId);
+    }
+
+    // Number of the len encoded keys that are less than key (or not greater, if upper).
+    template<bool upper>
+    int rank(const char* arr, int len, const T& key) const {
+        int low = 0;
+        while(len > 0){
+            int half = len / 2;
+            T probe = Record::decode(arr + (low + half) * Record::size);
+            if(upper ? !(key < probe) : probe < key){
+                low += half + 1;
+                len -= half + 1;
+            }
+            else{
+                len = half;
+            }
+        }
+        return low;
+    }
+
+    // Leaf where the first item not less than *key would be; the leftmost leaf if key is null.
+    Page find_leaf(const T* key) {
+        if(this->root == NO_PAGE){
+            return Page();
+        }
+        Page page = fetch(this->root, 0);
+        for(std::uint32_t depth=1; !page.header().is_leaf; depth++){
+            int index = key != nullptr ? rank<false>(keys(page), page.header().size, *key) : 0;
+            page = fetch(children(page)[index], depth);
+        }
+        return page;
+    }
+
+    // Call f on the items of the leaf chain from (leaf, index) on until it returns false.
+    template<typename Func>
+    void walk_leaves(Page leaf, int index, Func f) {
+        while(leaf.valid()){
+            for(int i=index; i<static_cast<int>(leaf.header().size); i++){
+                T item = Record::decode(records(leaf) + i * Record::size);
+                if(!f(item)){
+                    return;
+                }
+            }
+            PageId next = leaf.header().next;
+            if(next == NO_PAGE){
+                return;
+            }
+            leaf = fetch(next, this->levels);
+            index = 0;
+        }
+    }
+
+    // Insert data below page id. If the page splits, returns the new right page and sets
+    // separator to the smallest key under it; otherwise returns NO_PAGE.
+    PageId insert_into(PageId id, std::uint32_t depth, const T& data, T& separator) {
+        Page page = fetch(id, depth);
+        if(page.header().is_leaf){
+            int pos = rank<true>(records(page), page.header().size, data);
+            return leaf_insert(page, pos, data, separator);
+        }
+        int pos = rank<true>(keys(page), page.header().size, data);
+        T child_separator;
+        PageId right = insert_into(children(page)[pos], depth + 1, data, child_separator);
+        if(right == NO_PAGE){
+            return NO_PAGE;
+        }
+        return inner_insert(page, pos, child_separator, right, separator);
+    }
+
+    PageId leaf_insert(Page& leaf, int pos, const T& data, T& separator) {
+        const std::size_t R = Record::size;
+        const int cap = static_cast<int>(this->leaf_cap);
+        PageHeader& header = leaf.header();
+        char* recs = records(leaf);
+        leaf.touch();
+        if(static_cast<int>(header.size) < cap){
+            std::memmove(recs + (pos + 1) * R, recs + pos * R, (header.size - pos) * R);
+            Record::encode(data, recs + pos * R);
+            header.size++;
+            return NO_PAGE;
+        }
+
+        //split: the left page keeps half of the cap+1 records
+        Page right = new_page(true);
+        char* right_recs = records(right);
+        int left_size = (cap + 1) / 2;
+        if(pos < left_size){
+            std::memcpy(right_recs, recs + (left_size - 1) * R, (cap - left_size + 1) * R);
+            std::memmove(recs + (pos + 1) * R, recs + pos * R, (left_size - 1 - pos) * R);
+            Record::encode(data, recs + pos * R);
+        }
+        else{
+            int right_pos = pos - left_size;
+            std::memcpy(right_recs, recs + left_size * R, right_pos * R);
+            Record::encode(data, right_recs + right_pos * R);
+            std::memcpy(right_recs + (right_pos + 1) * R, recs + pos * R, (cap - pos) * R);
+        }
+        header.size = left_size;
+        right.header().size = cap + 1 - left_size;
+        right.header().next = header.next;
+        header.next = right.page_id();
+        separator = bptree_separator(Record::decode(recs + (left_size - 1) * R), Record::decode(right_recs));
+        return right.page_id();
+    }
+
+    // Insert key at pos and its right child at pos+1, splitting the node if it is full.
+    PageId inner_insert(Page& node, int pos, const T& key, PageId child, T& separator) {
+        const std::size_t R = Record::size;
+        const int cap = static_cast<int>(this->inner_cap);
+        PageHeader& header = node.header();
+        int size = header.size;
+        node.touch();
+        if(size < cap){
+            std::memmove(keys(node) + (pos + 1) * R, keys(node) + pos * R, (size - pos) * R);
+            Record::encode(key, keys(node) + pos * R);
+            std::memmove(children(node) + pos + 2, children(node) + pos + 1, (size - pos) * sizeof(PageId));
+            children(node)[pos + 1] = child;
+            header.size++;
+            return NO_PAGE;
+        }
+
+        //split: lay out all cap+1 keys, push the middle one up
+        std::vector<char> all_keys((cap + 1) * R);
+        std::vector<PageId> all_children(cap + 2);
+        std::memcpy(all_keys.data(), keys(node), pos * R);
+        Record::encode(key, all_keys.data() + pos * R);
+        std::memcpy(all_keys.data() + (pos + 1) * R, keys(node) + pos * R, (cap - pos) * R);
+        std::copy(children(node), children(node) + pos + 1, all_children.begin());
+        all_children[pos + 1] = child;
+        std::copy(children(node) + pos + 1, children(node) + cap + 1, all_children.begin() + pos + 2);
+
+        int left_size = (cap + 1) / 2;
+        int right_size = cap - left_size;
+        Page right = new_page(false);
+        std::memcpy(keys(node), all_keys.data(), left_size * R);
+        std::copy(all_children.begin(), all_children.begin() + left_size + 1, children(node));
+        std::memcpy(keys(right), all_keys.data() + (left_size + 1) * R, right_size * R);
+        std::copy(all_children.begin() + left_size + 1, all_children.end(), children(right));
+        header.size = left_size;
+        right.header().size = right_size;
+        separator = Record::decode(all_keys.data() + left_size * R);
+        return right.page_id();
+    }
+
+    // Remove one item equal to data below page id; false if there is none. Items equal to data
+    // may sit under any child between the first key not less than it and the last key not
+    // greater, so those children are tried in order. A child left underfull is fixed on the way up.
+    bool remove_from(PageId id, std::uint32_t depth, const T& data) {
+        const std::size_t R = Record::size;
+        Page page = fetch(id, depth);
+        PageHeader& header = page.header();
+        if(header.is_leaf){
+            char* recs = records(page);
+            for(int i=rank<false>(recs, header.size, data); i<static_cast<int>(header.size); i++){
+                T item = Record::decode(recs + i * R);
+                if(data < item){
+                    return false;
+                }
+                if(item == data){
+                    std::memmove(recs + i * R, recs + (i + 1) * R, (header.size - i - 1) * R);
+                    header.size--;
+                    page.touch();
+                    return true;
+                }
+            }
+            return false;
+        }
+        int last = rank<true>(keys(page), header.size, data);
+        for(int pos=rank<false>(keys(page), header.size, data); pos<=last; pos++){
+            if(remove_from(children(page)[pos], depth + 1, data)){
+                rebalance(page, pos, depth + 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Child pos of node lost an item or a key: if it is under half full, move items over from a
+    // sibling, or merge the two when they fit in one page.
+    void rebalance(Page& node, int pos, std::uint32_t depth) {
+        Page child = fetch(children(node)[pos], depth);
+        bool leaf = child.header().is_leaf;
+        std::size_t min_size = leaf ? this->leaf_cap / 2 : this->inner_cap / 2;
+        if(child.header().size >= min_size){
+            return;
+        }
+        int sep = pos > 0 ? pos - 1 : pos; // key between the two siblings
+        Page left;
+        Page right;
+        if(pos > 0){
+            left = fetch(children(node)[pos - 1], depth);
+            right = std::move(child);
+        }
+        else{
+            left = std::move(child);
+            right = fetch(children(node)[pos + 1], depth);
+        }
+        if(leaf){
+            balance_leaves(node, sep, left, right);
+        }
+        else{
+            balance_inner(node, sep, left, right);
+        }
+    }
+
+    void balance_leaves(Page& node, int sep, Page& left, Page& right) {
+        const std::size_t R = Record::size;
+        int left_size = left.header().size;
+        int right_size = right.header().size;
+        int total = left_size + right_size;
+        left.touch();
+        right.touch();
+        if(total <= static_cast<int>(this->leaf_cap)){ //merge
+            std::memcpy(records(left) + left_size * R, records(right), right_size * R);
+            left.header().size = total;
+            left.header().next = right.header().next;
+            free_page(right);
+            drop_key(node, sep);
+            return;
+        }
+
+        int new_left = total / 2;
+        if(left_size > new_left){ //the tail of left goes to the front of right
+            int moved = left_size - new_left;
+            std::memmove(records(right) + moved * R, records(right), right_size * R);
+            std::memcpy(records(right), records(left) + new_left * R, moved * R);
+        }
+        else{
+            int moved = new_left - left_size;
+            std::memcpy(records(left) + left_size * R, records(right), moved * R);
+            std::memmove(records(right), records(right) + moved * R, (right_size - moved) * R);
+        }
+        left.header().size = new_left;
+        right.header().size = total - new_left;
+        T separator = bptree_separator(Record::decode(records(left) + (new_left - 1) * R), Record::decode(records(right)));
+        Record::encode(separator, keys(node) + sep * R);
+        node.touch();
+    }
+
+    // Same for internal nodes; the key between them in node comes down between the two halves.
+    void balance_inner(Page& node, int sep, Page& left, Page& right) {
+        const std::size_t R = Record::size;
+        int left_size = left.header().size;
+        int right_size = right.header().size;
+        int total = left_size + 1 + right_size;
+        left.touch();
+        right.touch();
+        if(total <= static_cast<int>(this->inner_cap)){ //merge
+            std::memcpy(keys(left) + left_size * R, keys(node) + sep * R, R);
+            std::memcpy(keys(left) + (left_size + 1) * R, keys(right), right_size * R);
+            std::copy(children(right), children(right) + right_size + 1, children(left) + left_size + 1);
+            left.header().size = total;
+            free_page(right);
+            drop_key(node, sep);
+            return;
+        }
+
+        std::vector<char> all_keys(total * R);
+        std::vector<PageId> all_children(total + 1);
+        std::memcpy(all_keys.data(), keys(left), left_size * R);
+        std::memcpy(all_keys.data() + left_size * R, keys(node) + sep * R, R);
+        std::memcpy(all_keys.data() + (left_size + 1) * R, keys(right), right_size * R);
+        std::copy(children(left), children(left) + left_size + 1, all_children.begin());
+        std::copy(children(right), children(right) + right_size + 1, all_children.begin() + left_size + 1);
+
+        int new_left = (total - 1) / 2;
+        int new_right = total - 1 - new_left;
+        std::memcpy(keys(left), all_keys.data(), new_left * R);
+        std::copy(all_children.begin(), all_children.begin() + new_left + 1, children(left));
+        std::memcpy(keys(node) + sep * R, all_keys.data() + new_left * R, R);
+        std::memcpy(keys(right), all_keys.data() + (new_left + 1) * R, new_right * R);
+        std::copy(all_children.begin() + new_left + 1, all_children.end(), children(right));
+        left.header().size = new_left;
+        right.header().size = new_right;
+        node.touch();
+    }
+
+    // Remove key sep and the child on its right from node.
+    void drop_key(Page& node, int sep) {
+        const std::size_t R = Record::size;
+        int size = node.header().size;
+        std::memmove(keys(node) + sep * R, keys(node) + (sep + 1) * R, (size - sep - 1) * R);
+        std::memmove(children(node) + sep + 1, children(node) + sep + 2, (size - sep - 1) * sizeof(PageId));
+        node.header().size--;
+        node.touch();
+    }
+
+    std::size_t bulk_capacity(std::size_t max, std::size_t min, double fill_factor){
+        auto cap = static_cast<std::size_t>(fill_factor * max);
+        return std::min(max, std::max(min, cap));
+    }
+
+public:
+    void insert(const T& data) {
+        if(this->root == NO_PAGE){
+            this->root = new_page(true).page_id();
+            this->levels = 1;
+        }
+        T separator;
+        PageId right = insert_into(this->root, 0, data, separator);
+        if(right != NO_PAGE){ //the root split: grow a level
+            Page node = new_page(false);
+            Record::encode(separator, keys(node));
+            children(node)[0] = this->root;
+            children(node)[1] = right;
+            node.header().size = 1;
+            this->root = node.page_id();
+            this->levels++;
+        }
+        this->count++;
+    }
+
+    // Remove one item equal to data; false if there is none.
+    bool remove(const T& data) {
+        if(this->root == NO_PAGE || !remove_from(this->root, 0, data)){
+            return false;
+        }
+        this->count--;
+        Page top = fetch(this->root, 0);
+        if(top.header().size == 0){ //shrink a level, or the tree is empty
+            PageId only = top.header().is_leaf ? NO_PAGE : children(top)[0];
+            free_page(top);
+            this->root = only;
+            this->levels--;
+        }
+        return true;
+    }
+
+    // Build the tree bottom-up from the sorted range [first, last), replacing its contents and
+    // truncating the file. Leaves are written left to right, so this is one sequential pass.
+    template<typename It>
+    void bulk_load(It first, It last, double fill_factor = 1.0) {
+        this->pool.truncate(1);
+        this->free_list = 0;
+        this->root = NO_PAGE;
+        this->levels = 0;
+        this->count = std::distance(first, last);
+        if(this->count == 0){
+            return;
+        }
+
+        //leaf level
+        std::size_t leaf_fill = bulk_capacity(this->leaf_cap, std::max<std::size_t>(1, this->leaf_cap/2), fill_factor);
+        std::size_t leaf_count = (this->count + leaf_fill - 1) / leaf_fill;
+        std::vector<PageId> level;
+        std::vector<T> level_min; // smallest and largest key under each node of the level
+        std::vector<T> level_max;
+        level.reserve(leaf_count);
+        level_min.reserve(leaf_count);
+        level_max.reserve(leaf_count);
+
+        Page prev;
+        for(std::size_t n=0; n<leaf_count; n++){
+            Page leaf = new_page(true);
+            std::size_t size = this->count / leaf_count + (n < this->count % leaf_count ? 1 : 0); // spread evenly
+            for(std::size_t i=0; i<size; i++, ++first){
+                Record::encode(*first, records(leaf) + i * Record::size);
+            }
+            leaf.header().size = size;
+            if(prev.valid()){
+                prev.header().next = leaf.page_id();
+            }
+            level.push_back(leaf.page_id());
+            level_min.push_back(Record::decode(records(leaf)));
+            level_max.push_back(Record::decode(records(leaf) + (size - 1) * Record::size));
+            prev = std::move(leaf);
+        }
+        prev.release();
+        this->levels = 1;
+
+        //internal levels
+        std::size_t child_fill = bulk_capacity(this->inner_cap + 1, std::max<std::size_t>(2, (this->inner_cap + 2)/2), fill_factor);
+        while(level.size() > 1){
+            std::size_t node_count = (level.size() + child_fill - 1) / child_fill;
+            std::vector<PageId> upper;
+            std::vector<T> upper_min;
+            std::vector<T> upper_max;
+            upper.reserve(node_count);
+            upper_min.reserve(node_count);
+            upper_max.reserve(node_count);
+
+            std::size_t next = 0;
+            for(std::size_t n=0; n<node_count; n++){
+                std::size_t child_count = level.size() / node_count + (n < level.size() % node_count ? 1 : 0);
+                Page node = new_page(false);
+                for(std::size_t c=0; c<child_count; c++, next++){
+                    children(node)[c] = level[next];
+                    if(c > 0){
+                        Record::encode(bptree_separator(level_max[next - 1], level_min[next]), keys(node) + (c - 1) * Record::size);
+                    }
+                }
+                node.header().size = child_count - 1;
+                upper.push_back(node.page_id());
+                upper_min.push_back(std::move(level_min[next - child_count]));
+                upper_max.push_back(std::move(level_max[next - 1]));
+            }
+            level.swap(upper);
+            level_min.swap(upper_min);
+            level_max.swap(upper_max);
+            this->levels++;
+        }
+        this->root = level[0];
+        write_meta();
+    }
+
+    // Copy the items between start and end (same bounds as range_for_each) into result_data.
+    // Stops after arr_length items; range_for_each has no such limit.
+    int range_search(const T& start, const T& end, T* result_data, int arr_length) {
+        int index=0;
+        range_for_each(start, end, [&](T& item){
+            if(index == arr_length){
+                return false;
+            }
+            result_data[index++] = item;
+            return true;
+        });
+        return index;
+    }
+    bool search(const T& data) {  // Return true if the item exists. Return false if it does not.
+        bool found = false;
+        Page leaf = find_leaf(&data);
+        if(leaf.valid()){
+            int index = rank<false>(records(leaf), leaf.header().size, data);
+            walk_leaves(std::move(leaf), index, [&](T& item){
+                if(data < item){
+                    return false;
+                }
+                found = item == data;
+                return !found;
+            });
+        }
+        return found;
+    }
+
+    // Call f on every item from the first one not less than start while item <= end, in order.
+    // f gets a decoded copy: changing it does not change the page. Returning false stops the scan.
+    template<typename Func>
+    void range_for_each(const T& start, const T& end, Func f) {
+        Page leaf = find_leaf(&start);
+        if(!leaf.valid()){
+            return;
+        }
+        int index = rank<false>(records(leaf), leaf.header().size, start);
+        walk_leaves(std::move(leaf), index, [&](T& item){
+            if(!(item <= end)){
+                return false;
+            }
+            if constexpr (std::is_same<decltype(f(item)), bool>::value) {
+                return f(item);
+            }
+            else {
+                f(item);
+                return true;
+            }
+        });
+    }
+
+    // Call f on every item in order (decoded copies, like range_for_each).
+    template<typename Func>
+    void for_each(Func f) {
+        walk_leaves(find_leaf(nullptr), 0, [&](T& item) {
+            f(item);
+            return true;
+        });
+    }
+};
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef Parallel_H
+#define Parallel_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// threads, or one per core if it is 0.
+inline unsigned parallel_threads(unsigned threads = 0) {
+    if(threads == 0){
+        threads = std::thread::hardware_concurrency();
+    }
+    return std::max(1u, threads);
+}
+
+// Worker threads shared by every parallel_run: parallel_threads()-1 of them, started on first
+// use and kept until exit, so a call costs a hand-off instead of starting threads. A batch is
+// one parallel_run; its jobs are handed out one at a time to the workers and to the thread that
+// called parallel_run, which also runs jobs until none are left. A job may call parallel_run
+// itself: its thread then runs the inner batch's jobs, so nesting can't deadlock even with every
+// worker busy.
+class ParallelPool {
+public:
+    struct Batch {
+        void (*call)(void* job, std::size_t index);
+        void* job;
+        std::size_t count;
+        std::size_t next = 0; // first job not handed out yet
+        std::size_t done = 0;
+        std::vector<std::exception_ptr> errors;
+    };
+
+    static ParallelPool& instance() {
+        static ParallelPool pool(parallel_threads() - 1);
+        return pool;
+    }
+
+    // Run every job of batch and return once all of them have finished.
+    void run(Batch& batch) {
+        std::unique_lock<std::mutex> guard(this->lock);
+        this->queue.push_back(&batch);
+        this->work.notify_all();
+        while(batch.next < batch.count){
+            std::size_t index = claim(batch);
+            guard.unlock();
+            execute(batch, index);
+            guard.lock();
+            finish(batch);
+        }
+        this->finished.wait(guard, [&]{ return batch.done == batch.count; });
+    }
+
+    ~ParallelPool() {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->stop = true;
+        }
+        this->work.notify_all();
+        for(std::thread& worker : this->workers){
+            worker.join();
+        }
+    }
+    ParallelPool(const ParallelPool&) = delete;
+    ParallelPool& operator=(const ParallelPool&) = delete;
+
+private:
+    std::mutex lock;
+    std::condition_variable work;     // a batch was queued, or stop
+    std::condition_variable finished; // a job finished
+    std::deque<Batch*> queue;         // batches with jobs not handed out yet
+    std::vector<std::thread> workers;
+    bool stop = false;
+
+    explicit ParallelPool(unsigned count) {
+        for(unsigned i=0; i<count; i++){
+            this->workers.emplace_back([this]{ serve(); });
+        }
+    }
+
+    // Hand out the next job of batch; the batch leaves the queue with its last one. Locked.
+    std::size_t claim(Batch& batch) {
+        std::size_t index = batch.next++;
+        if(batch.next == batch.count){
+            this->queue.erase(std::find(this->queue.begin(), this->queue.end(), &batch));
+        }
+        return index;
+    }
+    static void execute(Batch& batch, std::size_t index) {
+        try{
+            batch.call(batch.job, index);
+        }
+        catch(...){
+            batch.errors[index] = std::current_exception();
+        }
+    }
+    // Locked. Once done reaches count the batch may be gone: nothing touches it after this.
+    void finish(Batch& batch) {
+        if(++batch.done == batch.count){
+            this->finished.notify_all();
+        }
+    }
+
+    void serve() {
+        std::unique_lock<std::mutex> guard(this->lock);
+        while(true){
+            this->work.wait(guard, [this]{ return this->stop || !this->queue.empty(); });
+            if(this->stop){
+                return;
+            }
+            Batch& batch = *this->queue.front();
+            std::size_t index = claim(batch);
+            guard.unlock();
+            execute(batch, index);
+            guard.lock();
+            finish(batch);
+        }
+    }
+};
+
+// Run job(0) ... job(count-1) on the pool's workers and the calling thread, and wait for all of
+// them. The first exception a job threw, if any, is rethrown once every job has finished.
+template <typename Job>
+void parallel_run(std::size_t count, Job job) {
+    if(count <= 1){
+        if(count == 1){
+            job(0);
+        }
+        return;
+    }
+    ParallelPool::Batch batch;
+    batch.call = [](void* erased, std::size_t index){ (*static_cast<Job*>(erased))(index); };
+    batch.job = &job;
+    batch.count = count;
+    batch.errors.resize(count);
+    ParallelPool::instance().run(batch);
+    for(std::exception_ptr& error : batch.errors){
+        if(error){
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// std::stable_sort over threads threads: the range is cut into one part per thread, the parts are
+// sorted at the same time, and then merged pairwise, the merges of each round also in parallel.
+template <typename RandomIt, typename Compare>
+void parallel_stable_sort(RandomIt first, RandomIt last, Compare comp, unsigned threads = 0) {
+    std::size_t count = static_cast<std::size_t>(last - first);
+    std::size_t parts = std::min<std::size_t>(parallel_threads(threads), count / 4096);
+    if(parts <= 1){
+        std::stable_sort(first, last, comp);
+        return;
+    }
+    std::vector<RandomIt> bounds;
+    for(std::size_t part=0; part<=parts; part++){
+        bounds.push_back(first + count * part / parts);
+    }
+    parallel_run(parts, [&](std::size_t part){
+        std::stable_sort(bounds[part], bounds[part+1], comp);
+    });
+    for(std::size_t width=1; width<parts; width*=2){
+        std::size_t merges = (parts + 2 * width - 1) / (2 * width);
+        parallel_run(merges, [&](std::size_t merge){
+            std::size_t left = merge * 2 * width;
+            std::size_t middle = std::min(left + width, parts);
+            std::size_t right = std::min(left + 2 * width, parts);
+            if(middle < right){
+                std::inplace_merge(bounds[left], bounds[middle], bounds[right], comp);
+            }
+        });
+    }
+}
+
+template <typename RandomIt>
+void parallel_stable_sort(RandomIt first, RandomIt last, unsigned threads = 0) {
+    parallel_stable_sort(first, last, std::less<typename std::iterator_traits<RandomIt>::value_type>(), threads);
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef RowStore_H
+#define RowStore_H
+
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Something kept in step with a RowStore, such as a SecondaryIndex.
+template <typename T>
+class RowStoreListener {
+public:
+    virtual ~RowStoreListener() {}
+    virtual void row_added(std::uint32_t row) = 0;
+    // Rows [first, last) were appended together.
+    virtual void rows_added(std::uint32_t first, std::uint32_t last) {
+        for(std::uint32_t row=first; row<last; row++){
+            row_added(row);
+        }
+    }
+    virtual void row_removed(std::uint32_t row) = 0; // the record is still readable here
+};
+
+// Append-only record store. A record keeps its row id for the life of the store: removing it
+// tells the listeners and then only marks the row dead.
+template <typename T>
+class RowStore {
+    std::vector<T> records;
+    std::vector<bool> dead;
+    std::size_t dead_count;
+    std::vector<RowStoreListener<T>*> listeners;
+    std::mutex listeners_lock; // indexes may start listening from several threads at once
+
+public:
+    using value_type = T;
+    static constexpr std::uint32_t MAX_ROWS = 0xfffffffeu; // larger ids are reserved for probes
+
+    RowStore() : dead_count(0) {}
+    RowStore(const RowStore&) = delete;
+    RowStore& operator=(const RowStore&) = delete;
+
+    std::uint32_t append(T record) {
+        if(this->records.size() >= MAX_ROWS){
+            throw std::length_error("RowStore: out of row ids");
+        }
+        std::uint32_t row = static_cast<std::uint32_t>(this->records.size());
+        this->records.push_back(std::move(record));
+        this->dead.push_back(false);
+        for(RowStoreListener<T>* listener : this->listeners){
+            listener->row_added(row);
+        }
+        return row;
+    }
+    // Append a batch of records; listeners hear about them once. Returns the first row id.
+    std::uint32_t append_batch(std::vector<T> batch) {
+        if(batch.size() > MAX_ROWS - this->records.size()){
+            throw std::length_error("RowStore: out of row ids");
+        }
+        std::uint32_t first = static_cast<std::uint32_t>(this->records.size());
+        if(this->records.empty()){ //an empty store takes the batch's buffer as is
+            this->records = std::move(batch);
+        }
+        else{
+            this->records.insert(this->records.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        }
+        this->dead.resize(this->records.size(), false);
+        std::uint32_t last = static_cast<std::uint32_t>(this->records.size());
+        for(RowStoreListener<T>* listener : this->listeners){
+            listener->rows_added(first, last);
+        }
+        return first;
+    }
+    void remove(std::uint32_t row) {
+        if(row >= this->records.size() || this->dead[row]){
+            return;
+        }
+        for(RowStoreListener<T>* listener : this->listeners){
+            listener->row_removed(row);
+        }
+        this->dead[row] = true;
+        this->dead_count++;
+    }
+    void reserve(std::size_t rows) {
+        this->records.reserve(rows);
+        this->dead.reserve(rows);
+    }
+
+    const T& operator[](std::uint32_t row) const {
+        return this->records[row];
+    }
+    bool live(std::uint32_t row) const {
+        return row < this->records.size() && !this->dead[row];
+    }
+    // Rows ever appended; row ids run from 0 to size()-1.
+    std::uint32_t size() const {
+        return static_cast<std::uint32_t>(this->records.size());
+    }
+    std::size_t live_size() const {
+        return this->records.size() - this->dead_count;
+    }
+
+    // Only these two are locked: appends and removes must not run alongside them.
+    void listen(RowStoreListener<T>* listener) {
+        std::lock_guard<std::mutex> guard(this->listeners_lock);
+        this->listeners.push_back(listener);
+    }
+    void unlisten(RowStoreListener<T>* listener) {
+        std::lock_guard<std::mutex> guard(this->listeners_lock);
+        this->listeners.erase(std::remove(this->listeners.begin(), this->listeners.end(), listener), this->listeners.end());
+    }
+};
+
+#endif
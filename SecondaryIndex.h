@@ -0,0 +1,247 @@
+#ifndef SecondaryIndex_H
+#define SecondaryIndex_H
+
+#include "BPlusTree.h"
+#include "Parallel.h"
+#include "RowStore.h"
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A row of a SecondaryIndex, or a search bound (probe) holding a key. Entries are ordered by
+// (key, row), so every row has exactly one entry and remove can find it.
+template <typename Store, typename KeyExtractor>
+class SecondaryIndexEntry {
+    using Record = typename Store::value_type;
+    using Key = typename std::decay<decltype(KeyExtractor()(std::declval<const Record&>()))>::type;
+
+    static constexpr std::uint32_t LOW = 0xfffffffeu; // probe rows, see RowStore::MAX_ROWS
+    static constexpr std::uint32_t HIGH = 0xffffffffu;
+
+    union {
+        const Store* store;
+        const Key* probe;
+    };
+    std::uint32_t row;
+
+    template<typename F>
+    bool with_key(F f) const {
+        if(this->row >= LOW){
+            return f(*this->probe);
+        }
+        return f(KeyExtractor()((*this->store)[this->row]));
+    }
+    // Tie-break between equal keys: lower probe, rows, upper probe.
+    std::int64_t rank() const {
+        return this->row == LOW ? -1 : std::int64_t(this->row);
+    }
+
+public:
+    SecondaryIndexEntry() : store(nullptr), row(0) {}
+    SecondaryIndexEntry(const Store* _store, std::uint32_t _row) : store(_store), row(_row) {}
+    static SecondaryIndexEntry lower(const Key& key) { SecondaryIndexEntry e; e.probe = &key; e.row = LOW; return e; }
+    static SecondaryIndexEntry upper(const Key& key) { SecondaryIndexEntry e; e.probe = &key; e.row = HIGH; return e; }
+
+    std::uint32_t row_id() const { return this->row; }
+    const Record& record() const { return (*this->store)[this->row]; } // not for probes
+
+    bool operator<(const SecondaryIndexEntry& other) const {
+        return with_key([&](const auto& a){
+            return other.with_key([&](const auto& b){
+                return a < b || (!(b < a) && this->rank() < other.rank());
+            });
+        });
+    }
+    // Against an upper probe this is the key's own <=, which is what range ends mean.
+    bool operator<=(const SecondaryIndexEntry& other) const {
+        if(other.row == HIGH){
+            return with_key([&](const auto& a){
+                return other.with_key([&](const auto& b){ return a <= b; });
+            });
+        }
+        return !(other < *this);
+    }
+    bool operator==(const SecondaryIndexEntry& other) const {
+        return !(*this < other) && !(other < *this);
+    }
+};
+
+template <typename KeyExtractor, typename Record, typename = void>
+struct secondary_index_has_column : std::false_type {};
+template <typename KeyExtractor, typename Record>
+struct secondary_index_has_column<KeyExtractor, Record, decltype(void(KeyExtractor::column(std::declval<const Record&>())))>
+    : std::true_type {};
+
+// An extractor with a column gives the entries that column, read from their record.
+template <typename Store, typename KeyExtractor>
+struct BPlusTreeKey<SecondaryIndexEntry<Store, KeyExtractor>,
+                    typename std::enable_if<secondary_index_has_column<KeyExtractor, typename Store::value_type>::value>::type> {
+    static constexpr bool normalized = false;
+    static auto column(const SecondaryIndexEntry<Store, KeyExtractor>& entry) {
+        return KeyExtractor::column(entry.record());
+    }
+};
+
+// Ordered index over the records of a Store (a RowStore), kept in step with it: appended rows
+// are inserted and removed rows dropped. Entries are row ids, so no key is copied and they stay
+// valid whatever happens to other rows.
+//
+// KeyExtractor is a stateless functor from a record to its key: a reference to a member, or a
+// std::tie of several for a composite key. Keys need <, and <= for range ends. It may also
+// have a static column(record), a float or 32-bit integer the index keeps next to the entries
+// in its leaves (see BPlusTreeKey::column) for the filtered scans.
+template <typename Store, typename KeyExtractor>
+class SecondaryIndex : public RowStoreListener<typename Store::value_type> {
+public:
+    using Record = typename Store::value_type;
+    using Key = typename std::decay<decltype(KeyExtractor()(std::declval<const Record&>()))>::type;
+
+    using Entry = SecondaryIndexEntry<Store, KeyExtractor>;
+    using ColumnRange = typename BPlusTree<Entry>::column_range;
+
+private:
+    Store* store;
+    BPlusTree<Entry> tree;
+    std::size_t count;
+
+public:
+    // Index the live rows of store and follow it from then on. sorted_rows, if given, are the
+    // store.live_size() live rows already in index order (from a snapshot), which skips the sort;
+    // otherwise the rows are sorted on threads threads. Several indexes of one store may be built
+    // at the same time, as long as nothing changes the store meanwhile.
+    SecondaryIndex(Store& _store, const std::uint32_t* sorted_rows = nullptr, std::size_t degree = 50, unsigned threads = 1)
+        : store(&_store), tree(degree), count(0) {// Constructor
+        std::vector<Entry> entries;
+        entries.reserve(_store.live_size());
+        if(sorted_rows != nullptr){
+            for(std::size_t i=0; i<_store.live_size(); i++){
+                entries.emplace_back(this->store, sorted_rows[i]);
+            }
+        }
+        else{
+            for(std::uint32_t row=0; row<_store.size(); row++){
+                if(_store.live(row)){
+                    entries.emplace_back(this->store, row);
+                }
+            }
+            parallel_stable_sort(entries.begin(), entries.end(), threads); // entries are unique, so stable or not is the same
+        }
+        this->count = entries.size();
+        this->tree.bulk_load(entries.begin(), entries.end());
+        _store.listen(this);
+    }
+    ~SecondaryIndex() {
+        this->store->unlisten(this);
+    }
+    SecondaryIndex(const SecondaryIndex&) = delete;
+    SecondaryIndex& operator=(const SecondaryIndex&) = delete;
+
+    void row_added(std::uint32_t row) override {
+        this->tree.insert(Entry(this->store, row));
+        this->count++;
+    }
+    void rows_added(std::uint32_t first, std::uint32_t last) override {
+        std::vector<Entry> entries;
+        entries.reserve(last - first);
+        for(std::uint32_t row=first; row<last; row++){
+            entries.emplace_back(this->store, row);
+        }
+        this->tree.insert_batch(std::move(entries));
+        this->count += last - first;
+    }
+    // Removed rows are tombstoned, and the tree is compacted once they make up a fifth of it,
+    // so a purge of many rows costs a descent each plus one rebuild.
+    void row_removed(std::uint32_t row) override {
+        this->tree.tombstone(Entry(this->store, row));
+        this->count--;
+        if(this->tree.tombstones() > this->count / 4){
+            this->tree.compact();
+        }
+    }
+
+    std::size_t size() const {
+        return this->count;
+    }
+    BPlusTreeStats stats() {
+        return this->tree.stats();
+    }
+    BPlusTreeCounters counters() const {
+        return this->tree.counters();
+    }
+    void write_json(std::ostream& out) {
+        this->tree.write_json(out);
+    }
+
+    // Call f on the records whose key k has start <= k and k <= end, in key order (rows with
+    // equal keys in row order). If f returns bool, returning false stops the scan.
+    template<typename Func>
+    void range_for_each(const Key& start, const Key& end, Func f) {
+        this->tree.range_for_each(Entry::lower(start), Entry::upper(end), [&](const Entry& e){
+            const Record& record = (*this->store)[e.row_id()];
+            if constexpr (std::is_same<decltype(f(record)), bool>::value) {
+                return f(record);
+            }
+            else {
+                f(record);
+                return true;
+            }
+        });
+    }
+    // The same, restricted to the records whose column value is in filter; the records the
+    // filter rejects are not read.
+    template<typename Func>
+    void range_for_each(const Key& start, const Key& end, const ColumnRange& filter, Func f) {
+        this->tree.range_for_each(Entry::lower(start), Entry::upper(end), filter, [&](const Entry& e){
+            const Record& record = e.record();
+            if constexpr (std::is_same<decltype(f(record)), bool>::value) {
+                return f(record);
+            }
+            else {
+                f(record);
+                return true;
+            }
+        });
+    }
+    template<typename Func>
+    void equal_for_each(const Key& key, Func f) {
+        range_for_each(key, key, f);
+    }
+    // Parallel scans over the records, see BPlusTree::parallel_for_each and parallel_range_reduce.
+    template<typename Func>
+    void parallel_for_each(Func f, unsigned threads = 0) {
+        this->tree.parallel_for_each([&](const Entry& e){
+            f((*this->store)[e.row_id()]);
+        }, threads);
+    }
+    template<typename R, typename Map, typename Reduce>
+    R parallel_range_reduce(const Key& start, const Key& end, R init, Map map, Reduce reduce, unsigned threads = 0) {
+        return this->tree.parallel_range_reduce(Entry::lower(start), Entry::upper(end), std::move(init), [&](R& acc, const Entry& e){
+            map(acc, (*this->store)[e.row_id()]);
+        }, reduce, threads);
+    }
+    template<typename R, typename Map, typename Reduce>
+    R parallel_range_reduce(const Key& start, const Key& end, const ColumnRange& filter, R init, Map map, Reduce reduce, unsigned threads = 0) {
+        return this->tree.parallel_range_reduce(Entry::lower(start), Entry::upper(end), filter, std::move(init), [&](R& acc, const Entry& e){
+            map(acc, e.record());
+        }, reduce, threads);
+    }
+    // Call f on every row id in index order.
+    template<typename Func>
+    void for_each_row(Func f) {
+        this->tree.for_each([&](const Entry& e){
+            f(e.row_id());
+        });
+    }
+    // Call f on the row id of every record with key key, in row order.
+    template<typename Func>
+    void equal_for_each_row(const Key& key, Func f) {
+        this->tree.range_for_each(Entry::lower(key), Entry::upper(key), [&](const Entry& e){
+            f(e.row_id());
+            return true;
+        });
+    }
+};
+
+#endif
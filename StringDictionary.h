@@ -0,0 +1,80 @@
+#ifndef StringDictionary_H
+#define StringDictionary_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Interns strings as dense ids 0, 1, 2, ... so that records can store, compare and hash a
+// uint32_t instead of the string. Each string is kept once, for lookups and output.
+class StringDictionary {
+    std::deque<std::string> strings; // by id; a deque, so the views in ids stay valid
+    std::unordered_map<std::string_view, std::uint32_t> ids;
+
+public:
+    static constexpr std::uint32_t NONE = 0xffffffffu; // no string; never an id
+
+    StringDictionary() {}
+    StringDictionary(const StringDictionary&) = delete;
+    StringDictionary& operator=(const StringDictionary&) = delete;
+
+    // Id of s, which is added if it is new.
+    std::uint32_t intern(std::string_view s) {
+        auto found = this->ids.find(s);
+        if(found != this->ids.end()){
+            return found->second;
+        }
+        if(this->strings.size() >= NONE){
+            throw std::length_error("StringDictionary: out of ids");
+        }
+        std::uint32_t id = static_cast<std::uint32_t>(this->strings.size());
+        this->strings.emplace_back(s);
+        this->ids.emplace(this->strings.back(), id);
+        return id;
+    }
+    // Id of s, or NONE if it was never interned.
+    std::uint32_t find(std::string_view s) const {
+        auto found = this->ids.find(s);
+        return found != this->ids.end() ? found->second : NONE;
+    }
+    const std::string& operator[](std::uint32_t id) const {
+        return this->strings[id];
+    }
+    std::uint32_t size() const {
+        return static_cast<std::uint32_t>(this->strings.size());
+    }
+    void reserve(std::size_t count) {
+        this->ids.reserve(count);
+    }
+
+    // Renumber the strings in sorted order, so that comparing two ids compares their strings,
+    // and return the new id of every old one. Strings interned later get the next ids as usual.
+    std::vector<std::uint32_t> sort() {
+        std::vector<std::uint32_t> order(this->strings.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b){
+            return this->strings[a] < this->strings[b];
+        });
+        std::vector<std::uint32_t> renumber(order.size());
+        std::deque<std::string> sorted;
+        for(std::uint32_t id=0; id<order.size(); id++){
+            renumber[order[id]] = id;
+            sorted.push_back(std::move(this->strings[order[id]]));
+        }
+        this->strings.swap(sorted);
+        this->ids.clear();
+        for(std::uint32_t id=0; id<this->strings.size(); id++){
+            this->ids.emplace(this->strings[id], id);
+        }
+        return renumber;
+    }
+};
+
+#endif
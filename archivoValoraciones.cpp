@@ -0,0 +1,340 @@
+#include "archivoValoraciones.h"
+#include "Parallel.h"
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char VBIN_MAGIC[8] = {'V', 'A', 'L', 'B', 'I', 'N', '0', '1'};
+static const uint32_t VBIN_VERSION = 1;
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+// Suma de verificación por palabras de 8 bytes, en cuatro carriles independientes para no
+// depender de la latencia de la multiplicación; los bytes del final cuentan rellenos con ceros
+static uint64_t checksum(const void *data, size_t bytes, uint64_t semilla = 0)
+{
+    const uint64_t K = 0x9E3779B97F4A7C15ull;
+    const char *p = static_cast<const char *>(data);
+    uint64_t h[4] = {semilla, semilla + 1, semilla + 2, semilla + 3};
+    size_t palabras = bytes / 8;
+    size_t i = 0;
+    for (; i + 4 <= palabras; i += 4)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            uint64_t palabra;
+            memcpy(&palabra, p + (i + c) * 8, 8);
+            h[c] = (h[c] ^ palabra) * K;
+            h[c] ^= h[c] >> 29;
+        }
+    }
+    for (; i < palabras; i++)
+    {
+        uint64_t palabra;
+        memcpy(&palabra, p + i * 8, 8);
+        h[0] = (h[0] ^ palabra) * K;
+        h[0] ^= h[0] >> 29;
+    }
+    if (bytes % 8 != 0)
+    {
+        uint64_t palabra = 0;
+        memcpy(&palabra, p + palabras * 8, bytes % 8);
+        h[1] = (h[1] ^ palabra) * K;
+        h[1] ^= h[1] >> 29;
+    }
+    uint64_t total = bytes;
+    for (int c = 0; c < 4; c++)
+        total = (total ^ h[c]) * K + (total >> 31);
+    return total;
+}
+
+static size_t bytesColumnas(uint64_t filas, bool tiempos)
+{
+    return 2 * align8(filas * 4) + align8(filas * 2) + (tiempos ? align8(filas * 4) : 0);
+}
+
+static void agregarRelleno(vector<char> &bufer, const void *data, size_t bytes)
+{
+    const char *p = static_cast<const char *>(data);
+    bufer.insert(bufer.end(), p, p + bytes);
+    bufer.resize(align8(bufer.size()), 0);
+}
+
+bool EscritorVbin::abrir(const string &path, uint32_t flags, uint32_t filasPorBloque)
+{
+    if (filasPorBloque == 0)
+        return false;
+    out.open(path, ios::binary | ios::trunc);
+    if (!out.is_open())
+        return false;
+    cabecera = CabeceraVbin();
+    memcpy(cabecera.magic, VBIN_MAGIC, sizeof(cabecera.magic));
+    cabecera.version = VBIN_VERSION;
+    cabecera.flags = flags;
+    cabecera.filasPorBloque = filasPorBloque;
+    // La cabecera definitiva se escribe al cerrar
+    out.write(reinterpret_cast<const char *>(&cabecera), sizeof(cabecera));
+    return static_cast<bool>(out);
+}
+
+void EscritorVbin::agregar(const Valoracion &v)
+{
+    usuario.push_back(v.usuario);
+    cancion.push_back(v.cancion);
+    medias.push_back(v.medias);
+    if (cabecera.flags & VBIN_TIEMPOS)
+        tiempo.push_back(v.tiempo);
+    if (usuario.size() == cabecera.filasPorBloque)
+        escribirBloque();
+}
+
+void EscritorVbin::escribirBloque()
+{
+    vector<char> columnas;
+    columnas.reserve(bytesColumnas(usuario.size(), cabecera.flags & VBIN_TIEMPOS));
+    agregarRelleno(columnas, usuario.data(), usuario.size() * sizeof(uint32_t));
+    agregarRelleno(columnas, cancion.data(), cancion.size() * sizeof(uint32_t));
+    agregarRelleno(columnas, medias.data(), medias.size() * sizeof(uint16_t));
+    if (cabecera.flags & VBIN_TIEMPOS)
+        agregarRelleno(columnas, tiempo.data(), tiempo.size() * sizeof(uint32_t));
+
+    BloqueVbin bloque = {};
+    bloque.filas = static_cast<uint32_t>(usuario.size());
+    bloque.checksum = checksum(columnas.data(), columnas.size());
+    out.write(reinterpret_cast<const char *>(&bloque), sizeof(bloque));
+    out.write(columnas.data(), columnas.size());
+    cabecera.filas += usuario.size();
+    cabecera.bloques++;
+    usuario.clear();
+    cancion.clear();
+    medias.clear();
+    tiempo.clear();
+}
+
+bool EscritorVbin::cerrar(const CodigosValoraciones &codigos)
+{
+    if (!out.is_open())
+        return false;
+    if (!usuario.empty())
+        escribirBloque();
+
+    vector<CodigoVbin> tablaCodigos;
+    string pool;
+    for (const StringDictionary *diccionario : {&codigos.usuarios, &codigos.canciones})
+    {
+        for (uint32_t id = 0; id < diccionario->size(); id++)
+        {
+            const string &codigo = (*diccionario)[id];
+            if (pool.size() + codigo.size() > UINT32_MAX)
+            {
+                out.close();
+                return false;
+            }
+            tablaCodigos.push_back({static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(codigo.size())});
+            pool += codigo;
+        }
+    }
+    cabecera.usuarios = codigos.usuarios.size();
+    cabecera.canciones = codigos.canciones.size();
+    cabecera.diccionario = static_cast<uint64_t>(out.tellp());
+    cabecera.poolBytes = pool.size();
+    cabecera.checksumDiccionario = checksum(pool.data(), pool.size(), checksum(tablaCodigos.data(), tablaCodigos.size() * sizeof(CodigoVbin)));
+
+    static const char ceros[8] = {};
+    out.write(reinterpret_cast<const char *>(tablaCodigos.data()), tablaCodigos.size() * sizeof(CodigoVbin));
+    out.write(pool.data(), pool.size());
+    out.write(ceros, align8(pool.size()) - pool.size());
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&cabecera), sizeof(cabecera));
+    out.close();
+    return !out.fail();
+}
+
+LectorVbin::LectorVbin() : base(nullptr), longitud(0), cabecera(nullptr), tablaDeCodigos(nullptr), pool(nullptr) {}
+
+LectorVbin::~LectorVbin()
+{
+    cerrar();
+}
+
+uint64_t LectorVbin::posicionBloque(uint32_t b) const
+{
+    return align8(sizeof(CabeceraVbin)) + uint64_t(b) * (sizeof(BloqueVbin) + bytesColumnas(cabecera->filasPorBloque, cabecera->flags & VBIN_TIEMPOS));
+}
+
+bool LectorVbin::abrir(const string &path)
+{
+    cerrar();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CabeceraVbin))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *mapeo = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapeo == MAP_FAILED)
+        return false;
+    base = static_cast<const char *>(mapeo);
+    longitud = st.st_size;
+    cabecera = reinterpret_cast<const CabeceraVbin *>(base);
+
+    // Todo lo que se lea después queda dentro del archivo
+    const CabeceraVbin &c = *cabecera;
+    bool valida = memcmp(c.magic, VBIN_MAGIC, sizeof(c.magic)) == 0 && c.version == VBIN_VERSION &&
+                  c.filasPorBloque > 0 && c.filas <= longitud && c.bloques == (c.filas + c.filasPorBloque - 1) / c.filasPorBloque;
+    if (valida)
+    {
+        uint64_t finBloques = c.bloques == 0 ? align8(sizeof(CabeceraVbin))
+                                             : posicionBloque(c.bloques - 1) + sizeof(BloqueVbin) +
+                                                   bytesColumnas(c.filas - uint64_t(c.bloques - 1) * c.filasPorBloque, c.flags & VBIN_TIEMPOS);
+        uint64_t codigos = uint64_t(c.usuarios) + c.canciones;
+        valida = c.diccionario == finBloques && c.poolBytes <= longitud && codigos <= longitud &&
+                 c.diccionario + codigos * sizeof(CodigoVbin) + c.poolBytes <= longitud;
+    }
+    if (!valida)
+    {
+        cerrar();
+        return false;
+    }
+    tablaDeCodigos = reinterpret_cast<const CodigoVbin *>(base + c.diccionario);
+    pool = base + c.diccionario + (uint64_t(c.usuarios) + c.canciones) * sizeof(CodigoVbin);
+    return true;
+}
+
+void LectorVbin::cerrar()
+{
+    if (base != nullptr)
+        munmap(const_cast<char *>(base), longitud);
+    base = nullptr;
+    longitud = 0;
+    cabecera = nullptr;
+}
+
+ColumnasVbin LectorVbin::bloque(uint32_t b) const
+{
+    const char *p = base + posicionBloque(b);
+    ColumnasVbin columnas;
+    columnas.filas = reinterpret_cast<const BloqueVbin *>(p)->filas;
+    p += sizeof(BloqueVbin);
+    columnas.usuario = reinterpret_cast<const uint32_t *>(p);
+    p += align8(columnas.filas * sizeof(uint32_t));
+    columnas.cancion = reinterpret_cast<const uint32_t *>(p);
+    p += align8(columnas.filas * sizeof(uint32_t));
+    columnas.medias = reinterpret_cast<const uint16_t *>(p);
+    p += align8(columnas.filas * sizeof(uint16_t));
+    columnas.tiempo = (cabecera->flags & VBIN_TIEMPOS) ? reinterpret_cast<const uint32_t *>(p) : nullptr;
+    return columnas;
+}
+
+bool LectorVbin::bloqueValido(uint32_t b) const
+{
+    const BloqueVbin *bloque = reinterpret_cast<const BloqueVbin *>(base + posicionBloque(b));
+    uint64_t esperadas = b + 1 < cabecera->bloques ? cabecera->filasPorBloque : cabecera->filas - uint64_t(b) * cabecera->filasPorBloque;
+    return bloque->filas == esperadas &&
+           checksum(bloque + 1, bytesColumnas(bloque->filas, cabecera->flags & VBIN_TIEMPOS)) == bloque->checksum;
+}
+
+bool LectorVbin::cargar(CodigosValoraciones &codigos, vector<Valoracion> &valoraciones, unsigned hilos) const
+{
+    if (cabecera == nullptr || codigos.usuarios.size() != 0 || codigos.canciones.size() != 0)
+        return false;
+    uint64_t cuantosCodigos = uint64_t(cabecera->usuarios) + cabecera->canciones;
+    if (checksum(pool, cabecera->poolBytes, checksum(tablaDeCodigos, cuantosCodigos * sizeof(CodigoVbin))) != cabecera->checksumDiccionario)
+        return false;
+    for (uint64_t i = 0; i < cuantosCodigos; i++)
+    {
+        if (uint64_t(tablaDeCodigos[i].posicion) + tablaDeCodigos[i].longitud > cabecera->poolBytes)
+            return false;
+    }
+    // Los códigos se internan en el orden del archivo, así que conservan sus ids
+    codigos.usuarios.reserve(cabecera->usuarios);
+    for (uint32_t id = 0; id < cabecera->usuarios; id++)
+    {
+        if (codigos.usuarios.intern(codigo(id)) != id)
+            return false; // código repetido
+    }
+    codigos.canciones.reserve(cabecera->canciones);
+    for (uint32_t id = 0; id < cabecera->canciones; id++)
+    {
+        if (codigos.canciones.intern(codigo(cabecera->usuarios + id)) != id)
+            return false;
+    }
+
+    // Cada hilo comprueba y copia un tramo de bloques
+    size_t desde = valoraciones.size();
+    valoraciones.resize(desde + cabecera->filas);
+    size_t partes = min<size_t>(parallel_threads(hilos), max<uint32_t>(1, cabecera->bloques));
+    atomic<bool> correcto(true);
+    parallel_run(partes, [&](size_t parte)
+                 {
+        uint32_t fin = uint64_t(cabecera->bloques) * (parte + 1) / partes;
+        for (uint32_t b = uint64_t(cabecera->bloques) * parte / partes; b < fin && correcto; b++)
+        {
+            if (!bloqueValido(b))
+            {
+                correcto = false;
+                break;
+            }
+            ColumnasVbin columnas = bloque(b);
+            Valoracion *destino = valoraciones.data() + desde + uint64_t(b) * cabecera->filasPorBloque;
+            for (uint32_t i = 0; i < columnas.filas; i++)
+            {
+                if (columnas.usuario[i] >= cabecera->usuarios || columnas.cancion[i] >= cabecera->canciones)
+                {
+                    correcto = false;
+                    break;
+                }
+                destino[i].usuario = columnas.usuario[i];
+                destino[i].cancion = columnas.cancion[i];
+                destino[i].medias = columnas.medias[i];
+                destino[i].tiempo = columnas.tiempo != nullptr ? columnas.tiempo[i] : 0;
+            }
+        } });
+    if (!correcto)
+        valoraciones.resize(desde);
+    return correcto;
+}
+
+static bool enOrden(const StringDictionary &diccionario)
+{
+    for (uint32_t id = 1; id < diccionario.size(); id++)
+    {
+        if (!(diccionario[id - 1] < diccionario[id]))
+            return false;
+    }
+    return true;
+}
+
+bool guardarVbin(const string &path, const AlmacenValoraciones &almacen, const CodigosValoraciones &codigos)
+{
+    bool ordenado = enOrden(codigos.usuarios) && enOrden(codigos.canciones);
+    const Valoracion *anterior = nullptr;
+    for (uint32_t fila = 0; fila < almacen.size() && ordenado; fila++)
+    {
+        if (!almacen.live(fila))
+            continue;
+        if (anterior != nullptr && almacen[fila] < *anterior)
+            ordenado = false;
+        anterior = &almacen[fila];
+    }
+
+    EscritorVbin escritor;
+    if (!escritor.abrir(path, VBIN_TIEMPOS | (ordenado ? VBIN_ORDENADO : 0)))
+        return false;
+    for (uint32_t fila = 0; fila < almacen.size(); fila++)
+    {
+        if (almacen.live(fila))
+            escritor.agregar(almacen[fila]);
+    }
+    return escritor.cerrar(codigos);
+}
@@ -0,0 +1,123 @@
+#ifndef ARCHIVO_VALORACIONES_H
+#define ARCHIVO_VALORACIONES_H
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "valoracion.h"
+#include "valoracionIndices.h"
+
+using namespace std;
+
+// Formato binario por columnas para conjuntos de valoraciones (.vbin), para no volver a leer
+// texto en cada arranque. Little-endian, secciones alineadas a 8 bytes:
+//
+//   CabeceraVbin | bloque 0 | bloque 1 | ... | CodigoVbin[usuarios + canciones] | pool
+//
+// Un bloque tiene filasPorBloque filas (el último, las que queden): BloqueVbin y las columnas
+// usuario uint32[filas], cancion uint32[filas], medias uint16[filas] y, con VBIN_TIEMPOS,
+// tiempo uint32[filas]. Los ids son los del diccionario del final: los códigos de usuario y
+// luego los de canción, en orden de id. Cada bloque y el diccionario llevan una suma de
+// verificación. El diccionario va al final para que el escritor pueda escribir los bloques a
+// medida que llegan las filas.
+struct CabeceraVbin
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags; // VBIN_*
+    uint32_t usuarios;
+    uint32_t canciones;
+    uint64_t filas;
+    uint32_t filasPorBloque;
+    uint32_t bloques;
+    uint64_t diccionario; // posición de la tabla de códigos
+    uint64_t poolBytes;
+    uint64_t checksumDiccionario; // de la tabla de códigos y el pool
+};
+
+const uint32_t VBIN_TIEMPOS = 1;  // hay columna de tiempo
+const uint32_t VBIN_ORDENADO = 2; // ids en orden de código y filas en orden de Valoracion: se cargan sin ordenar
+
+struct BloqueVbin
+{
+    uint32_t filas;
+    uint32_t reservado;
+    uint64_t checksum; // de las columnas
+};
+
+struct CodigoVbin
+{
+    uint32_t posicion; // en el pool
+    uint32_t longitud;
+};
+
+// Las columnas de un bloque, leídas en el lugar
+struct ColumnasVbin
+{
+    uint32_t filas;
+    const uint32_t *usuario;
+    const uint32_t *cancion;
+    const uint16_t *medias;
+    const uint32_t *tiempo; // nullptr sin VBIN_TIEMPOS
+};
+
+// Escribe un .vbin bloque a bloque: agregar() guarda las filas y escribe cada bloque al llenarse,
+// cerrar() escribe el último, el diccionario y la cabecera definitiva.
+class EscritorVbin
+{
+    ofstream out;
+    CabeceraVbin cabecera;
+    vector<uint32_t> usuario, cancion, tiempo;
+    vector<uint16_t> medias;
+
+    void escribirBloque();
+
+public:
+    // flags: VBIN_TIEMPOS y/o VBIN_ORDENADO si las filas cumplen lo que dice
+    bool abrir(const string &path, uint32_t flags, uint32_t filasPorBloque = 65536);
+    void agregar(const Valoracion &v); // el tiempo solo se escribe con VBIN_TIEMPOS
+    // codigos: los de los ids de las filas. False si algo no se pudo escribir.
+    bool cerrar(const CodigosValoraciones &codigos);
+};
+
+// Abre un .vbin con mmap; las columnas se leen sin copiarlas.
+class LectorVbin
+{
+    const char *base;
+    size_t longitud;
+    const CabeceraVbin *cabecera;
+    const CodigoVbin *tablaDeCodigos;
+    const char *pool;
+
+    uint64_t posicionBloque(uint32_t b) const;
+
+public:
+    LectorVbin();
+    ~LectorVbin();
+    LectorVbin(const LectorVbin &) = delete;
+    LectorVbin &operator=(const LectorVbin &) = delete;
+
+    // False si no se puede leer o su estructura no es la de un .vbin; las sumas de verificación
+    // se comprueban al leer los bloques
+    bool abrir(const string &path);
+    void cerrar();
+
+    uint32_t flags() const { return cabecera->flags; }
+    uint64_t filas() const { return cabecera->filas; }
+    uint32_t bloques() const { return cabecera->bloques; }
+    ColumnasVbin bloque(uint32_t b) const;
+    bool bloqueValido(uint32_t b) const;
+    string_view codigo(uint32_t indice) const { return string_view(pool + tablaDeCodigos[indice].posicion, tablaDeCodigos[indice].longitud); }
+
+    // Llena codigos, que deben estar vacíos, y agrega las filas a valoraciones, con los bloques
+    // repartidos entre hilos hilos (0: uno por núcleo). False si una suma no coincide o un id
+    // está fuera de rango.
+    bool cargar(CodigosValoraciones &codigos, vector<Valoracion> &valoraciones, unsigned hilos = 0) const;
+};
+
+// Escribe las filas vivas de almacen, en orden de fila, como .vbin. Marca VBIN_ORDENADO si los
+// códigos y las filas ya están en orden, como tras una carga.
+bool guardarVbin(const string &path, const AlmacenValoraciones &almacen, const CodigosValoraciones &codigos);
+
+#endif // ARCHIVO_VALORACIONES_H
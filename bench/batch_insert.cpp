@@ -0,0 +1,96 @@
+// Batch ingest against single inserts (user-012): 1M random int keys inserted into a tree that
+// already holds 1M, one by one with insert and in batches of 1 to 1M with insert_batch; then
+// the same for ratings appended to the store with its four indexes listening, one by one with
+// append and in batches with append_batch. Prints millions of items per second.
+//
+//   g++ -std=c++17 -O2 -I. bench/batch_insert.cpp valoracion.cpp -o batch_insert -pthread && ./batch_insert
+//
+// Keys and ratings are random, so every batch spreads over the whole tree: a large batch pays
+// one descent per leaf it touches instead of one per item.
+#include "BPlusTree.h"
+#include "valoracionIndices.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static const std::size_t DEGREE = 64;
+static const int KEYS = 1000000;
+static const int RATINGS = 500000;
+static const int BATCHES[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Ratings appended to a store loaded with base, with the same four indexes as main.
+static double ratings_per_second(const std::vector<Valoracion>& base, const std::vector<Valoracion>& more, int batch) {
+    AlmacenValoraciones almacen;
+    almacen.append_batch(base);
+    IndicePorValor porValor(almacen);
+    IndicePorUsuario porUsuario(almacen);
+    IndicePorCancion porCancion(almacen);
+    IndicePorTiempo porTiempo(almacen);
+    int count = static_cast<int>(more.size());
+    auto start = std::chrono::steady_clock::now();
+    if(batch == 0){
+        for(const Valoracion& v : more){
+            almacen.append(v);
+        }
+    }
+    else{
+        for(int i=0; i<count; i+=batch){
+            almacen.append_batch(std::vector<Valoracion>(more.begin() + i, more.begin() + std::min(count, i + batch)));
+        }
+    }
+    return count / seconds_since(start) / 1e6;
+}
+
+int main() {
+    std::mt19937 rng(3);
+    std::vector<int> base(KEYS);
+    std::vector<int> more(KEYS);
+    for(int& key : base){
+        key = static_cast<int>(rng());
+    }
+    for(int& key : more){
+        key = static_cast<int>(rng());
+    }
+    std::sort(base.begin(), base.end());
+
+    std::printf("int keys, %d into %d\n", KEYS, KEYS);
+    {
+        BPlusTree<int> tree(DEGREE);
+        tree.bulk_load(base.begin(), base.end());
+        auto start = std::chrono::steady_clock::now();
+        for(int key : more){
+            tree.insert(key);
+        }
+        std::printf("  insert             %8.2f M/s\n", KEYS / seconds_since(start) / 1e6);
+    }
+    for(int batch : BATCHES){
+        BPlusTree<int> tree(DEGREE);
+        tree.bulk_load(base.begin(), base.end());
+        auto start = std::chrono::steady_clock::now();
+        for(int i=0; i<KEYS; i+=batch){
+            tree.insert_batch(std::vector<int>(more.begin() + i, more.begin() + std::min(KEYS, i + batch)));
+        }
+        std::printf("  insert_batch %7d %8.2f M/s\n", batch, KEYS / seconds_since(start) / 1e6);
+    }
+
+    std::vector<Valoracion> stored;
+    std::vector<Valoracion> incoming;
+    for(int i=0; i<2*RATINGS; i++){
+        Valoracion v(rng() % 100000, rng() % 20000, (1 + rng() % 10) * 0.5f, 900000000 + rng() % 600000000);
+        (i < RATINGS ? stored : incoming).push_back(v);
+    }
+    std::printf("ratings with four indexes, %d into %d\n", RATINGS, RATINGS);
+    std::printf("  append             %8.2f M/s\n", ratings_per_second(stored, incoming, 0));
+    for(int batch : BATCHES){
+        if(batch <= RATINGS){
+            std::printf("  append_batch %7d %8.2f M/s\n", batch, ratings_per_second(stored, incoming, batch));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Delete throughput and leaf fill after compaction (user-015): 500k of 1M int keys removed one
+// by one (remove rebalances at once), tombstoned (tombstone only marks the slot) or cut out
+// with erase_range, then compacted with the stop-the-world compact() and with compact_step
+// passes. Prints milliseconds and the leaf fill histogram after each.
+//
+//   g++ -std=c++17 -O2 -I. bench/delete_compact.cpp -o delete_compact && ./delete_compact
+//
+// The fill histogram counts leaves by live items in tenths of capacity, full leaves last.
+// compact() packs every leaf full; a compact_step pass only purges and brings each leaf back
+// to half full, so it leaves the tree the way remove does.
+#include "BPlusTree.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+static const std::size_t DEGREE = 50;
+static const int KEYS = 1000000;
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void print_fill(const char* what, double ms, BPlusTree<int>& tree) {
+    BPlusTreeStats stats = tree.stats();
+    std::printf("%-28s %8.1f ms  leaves %6zu  tombstones %6zu  fill", what, ms, stats.leaves, stats.tombstones);
+    for(std::size_t leaves : stats.leaf_fill){
+        std::printf(" %zu", leaves);
+    }
+    std::printf("\n");
+}
+
+// Both compactions of a copy of the tree the deletes left behind.
+template <typename Delete>
+static void run(const char* what, const std::vector<int>& keys, Delete erase) {
+    for(int online = 0; online < 2; online++){
+        BPlusTree<int> tree(DEGREE);
+        tree.bulk_load(keys.begin(), keys.end());
+        auto start = std::chrono::steady_clock::now();
+        erase(tree);
+        if(online == 0){
+            print_fill(what, ms_since(start), tree);
+        }
+        start = std::chrono::steady_clock::now();
+        if(online == 0){
+            tree.compact();
+            print_fill("  compact()", ms_since(start), tree);
+        }
+        else{
+            while(!tree.compact_step()){
+            }
+            print_fill("  compact_step() pass", ms_since(start), tree);
+        }
+    }
+}
+
+int main() {
+    std::vector<int> keys(KEYS);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::vector<int> doomed(keys);
+    std::shuffle(doomed.begin(), doomed.end(), std::mt19937(5));
+    doomed.resize(KEYS / 2);
+
+    run("remove 500k random", keys, [&](BPlusTree<int>& tree){
+        for(int key : doomed){
+            tree.remove(key);
+        }
+    });
+    run("tombstone 500k random", keys, [&](BPlusTree<int>& tree){
+        for(int key : doomed){
+            tree.tombstone(key);
+        }
+    });
+    run("remove 500k contiguous", keys, [&](BPlusTree<int>& tree){
+        for(int key = KEYS / 4; key < KEYS / 4 * 3; key++){
+            tree.remove(key);
+        }
+    });
+    run("erase_range 500k contiguous", keys, [&](BPlusTree<int>& tree){
+        tree.erase_range(KEYS / 4, KEYS / 4 * 3 - 1);
+    });
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Lookups per second of BPlusTree::search on random int keys, for the in-node search of
+// user-002 (binary search, and the branchless search of a compile-time fanout).
+//
+// After (this tree):
+//   g++ -std=c++17 -O2 -DWITH_FANOUT -I. bench/lookup_bench.cpp -o lookup_bench && ./lookup_bench
+// Before (the linear in-node search, commit 285f618):
+//   git worktree add /tmp/bpt-before 285f618
+//   g++ -std=c++17 -O2 -I/tmp/bpt-before bench/lookup_bench.cpp -o lookup_bench_before && ./lookup_bench_before
+//
+// Only search(), insert() and the degree constructor are used, so the same source builds
+// against both trees.
+#include "BPlusTree.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+static const std::size_t DEGREE = 50;
+static const std::size_t LOOKUPS = 2000000;
+
+template <typename Tree>
+static double lookups_per_second(Tree& tree, const std::vector<int>& probes) {
+    std::size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int key : probes){
+        found += tree.search(key);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(found != probes.size()){
+        std::printf("error: %zu of %zu keys found\n", found, probes.size());
+    }
+    return probes.size() / seconds;
+}
+
+template <typename Tree>
+static void run(const char* name, Tree& tree, std::size_t keys) {
+    std::mt19937 rng(42);
+    std::vector<int> order(keys);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    for(int key : order){
+        tree.insert(key);
+    }
+    std::vector<int> probes(LOOKUPS);
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(keys) - 1);
+    for(int& key : probes){
+        key = pick(rng);
+    }
+    lookups_per_second(tree, probes); // warm-up
+    std::printf("%-20s %8zu keys  %6.2f Mlookups/s\n", name, keys, lookups_per_second(tree, probes) / 1e6);
+}
+
+int main() {
+    for(std::size_t keys : {std::size_t(10000), std::size_t(1000000)}){
+        BPlusTree<int> tree(DEGREE);
+        run("int, degree 50", tree, keys);
+#ifdef WITH_FANOUT
+        BPlusTree<int, DEGREE> fixed;
+        run("int, Fanout 50", fixed, keys);
+#endif
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Read throughput of the thread-safe mode of BPlusTree (user-006) as reader threads are added,
+// without a writer and with one writer inserting the whole time. Each reader runs search() on
+// random pre-loaded keys for one second; the total is printed per reader count.
+//
+//   g++ -std=c++17 -O2 -I. bench/reader_scaling.cpp -o reader_scaling -pthread && ./reader_scaling
+//
+// Real scaling needs as many cores as readers plus one; on fewer cores the numbers only show
+// the cost of the latches. Reads are latch-coupled, not optimistic, so the writer column is
+// the one to watch: every insert holds exclusive latches that readers on its path wait for,
+// and only inserts run concurrently at all (remove and the other writes stop the readers).
+#include "BPlusTree.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+static const int KEYS = 1000000;
+
+// Millions of searches done in one second by readers threads, with or without a writer that
+// inserts random keys across the whole tree, so its latches sit on the readers' paths.
+static double reads_per_second(int readers, bool writing) {
+    BPlusTree<int> tree(50, true);
+    std::vector<int> keys(KEYS);
+    std::iota(keys.begin(), keys.end(), 0);
+    tree.bulk_load(keys.begin(), keys.end(), 0.7);
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> reads(0);
+    std::thread writer([&]{
+        std::mt19937 rng(readers);
+        std::uniform_int_distribution<int> pick(0, KEYS - 1);
+        while(writing && !stop){
+            tree.insert(pick(rng));
+        }
+    });
+    std::vector<std::thread> threads;
+    for(int r=0; r<readers; r++){
+        threads.emplace_back([&, r]{
+            std::mt19937 rng(r);
+            std::uniform_int_distribution<int> pick(0, KEYS - 1);
+            long mine = 0;
+            while(!stop){
+                mine += tree.search(pick(rng));
+            }
+            reads += mine;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    stop = true;
+    for(std::thread& t : threads){
+        t.join();
+    }
+    writer.join();
+    return reads / 1e6;
+}
+
+int main() {
+    unsigned cores = std::thread::hardware_concurrency();
+    std::printf("%u cores\n", cores);
+    std::printf("readers  no writer  one writer  (M reads/s)\n");
+    for(int readers : {1, 2, 4, 8, 16}){
+        std::printf("%7d  %9.2f  %10.2f\n", readers, reads_per_second(readers, false), reads_per_second(readers, true));
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Startup time from a CSV against a snapshot (user-008): reading and sorting the CSV and building
+// the four indexes by sorting, against mapping the .snap, copying its rows into the store in one
+// piece and building the indexes from the orders it stores. Prints each phase in milliseconds.
+//
+//   g++ -std=c++17 -O2 -I. bench/snapshot_open.cpp snapshot.cpp lectorCSV.cpp valoracion.cpp -o snapshot_open -pthread
+//   ./snapshot_open [rows]
+//
+// The CSV is generated (2M rows by default) next to the binary and removed at the end.
+#include "lectorCSV.h"
+#include "Parallel.h"
+#include "snapshot.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+static const char* CSV = "snapshot_open_bench.csv";
+static const char* SNAP = "snapshot_open_bench.snap";
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Indexes {
+    std::unique_ptr<IndicePorValor> porValor;
+    std::unique_ptr<IndicePorUsuario> porUsuario;
+    std::unique_ptr<IndicePorCancion> porCancion;
+    std::unique_ptr<IndicePorTiempo> porTiempo;
+
+    // Same as main: the four at once, each sorting with a quarter of the cores; a null order sorts
+    void build(AlmacenValoraciones& almacen, const Snapshot* snapshot) {
+        unsigned threads = std::max(1u, parallel_threads() / 4);
+        parallel_run(4, [&](std::size_t index){
+            if(index == 0)
+                porValor = std::make_unique<IndicePorValor>(almacen, snapshot ? snapshot->porValor() : nullptr, 50, threads);
+            else if(index == 1)
+                porUsuario = std::make_unique<IndicePorUsuario>(almacen, snapshot ? snapshot->porUsuario() : nullptr, 50, threads);
+            else if(index == 2)
+                porCancion = std::make_unique<IndicePorCancion>(almacen, snapshot ? snapshot->porCancion() : nullptr, 50, threads);
+            else
+                porTiempo = std::make_unique<IndicePorTiempo>(almacen, snapshot ? snapshot->porTiempo() : nullptr, 50, threads);
+        });
+    }
+};
+
+int main(int argc, char** argv) {
+    long rows = argc > 1 ? std::atol(argv[1]) : 2000000;
+    {
+        std::ofstream out(CSV);
+        out << "codigoUsuario,codigoCancion,valoracion,tiempo\n";
+        std::mt19937 rng(1);
+        for(long i=0; i<rows; i++){
+            out << "u" << rng() % 100000 << ",s" << rng() % 20000 << "," << (1 + rng() % 10) * 0.5 << ","
+                << 900000000 + rng() % 600000000 << "\n";
+        }
+    }
+    std::printf("%ld rows\n", rows);
+
+    // CSV: parse, renumber the ids in code order, sort the rows, then sort each index
+    {
+        auto start = std::chrono::steady_clock::now();
+        AlmacenValoraciones almacen;
+        CodigosValoraciones codigos;
+        std::vector<Valoracion> valoraciones;
+        LecturaCSV lectura;
+        if(!leerCSV(CSV, codigos, valoraciones, lectura)){
+            std::printf("can't read %s\n", CSV);
+            return 1;
+        }
+        double parsed = ms_since(start);
+        std::vector<std::uint32_t> idUsuario = codigos.usuarios.sort();
+        std::vector<std::uint32_t> idCancion = codigos.canciones.sort();
+        for(Valoracion& v : valoraciones){
+            v.usuario = idUsuario[v.usuario];
+            v.cancion = idCancion[v.cancion];
+        }
+        parallel_stable_sort(valoraciones.begin(), valoraciones.end());
+        almacen.append_batch(std::move(valoraciones));
+        double stored = ms_since(start);
+        Indexes indexes;
+        indexes.build(almacen, nullptr);
+        double total = ms_since(start);
+        std::printf("csv:      parse %8.1f  sort %8.1f  indexes %8.1f  total %8.1f ms\n", parsed, stored - parsed, total - stored, total);
+
+        if(!Snapshot::guardar(SNAP, almacen, codigos, *indexes.porValor, *indexes.porUsuario, *indexes.porCancion, *indexes.porTiempo)){
+            std::printf("can't write %s\n", SNAP);
+            return 1;
+        }
+    }
+
+    // Snapshot: map, copy the rows in one piece, check the stored orders and build from them
+    {
+        auto start = std::chrono::steady_clock::now();
+        AlmacenValoraciones almacen;
+        CodigosValoraciones codigos;
+        Snapshot snapshot;
+        if(!snapshot.abrir(SNAP) || !snapshot.cargar(almacen, codigos)){
+            std::printf("can't load %s\n", SNAP);
+            return 1;
+        }
+        double loaded = ms_since(start);
+        Indexes indexes;
+        indexes.build(almacen, &snapshot);
+        snapshot.cerrar();
+        double total = ms_since(start);
+        std::printf("snapshot: load  %8.1f  %14s  indexes %8.1f  total %8.1f ms\n", loaded, "", total - loaded, total);
+    }
+    unlink(CSV);
+    unlink(SNAP);
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "indicePaginado.h"
+#include "archivoValoraciones.h"
+#include "Parallel.h"
+#include <unistd.h>
+
+IndicePaginado::IndicePaginado() : cuantosUsuarios(0), cuantasCanciones(0) {}
+
+bool IndicePaginado::abrir(const string &path, CodigosValoraciones &codigos, size_t memoria)
+{
+    LectorVbin lectorCodigos;
+    vector<Valoracion> sinFilas;
+    if (!lectorCodigos.abrir(path + ".codigos") || lectorCodigos.filas() != 0 || !lectorCodigos.cargar(codigos, sinFilas))
+        return false;
+    cuantosUsuarios = codigos.usuarios.size();
+    cuantasCanciones = codigos.canciones.size();
+
+    // PagedBPlusTree crea el archivo si no existe; aquí que falte es un error
+    for (const char *sufijo : {"", ".usuarios", ".canciones"})
+    {
+        if (::access((path + sufijo).c_str(), R_OK | W_OK) != 0)
+            return false;
+    }
+    porValor = make_unique<PagedBPlusTree<Valoracion>>(path, memoria / 3);
+    porUsuario = make_unique<PagedBPlusTree<ValoracionPorUsuario>>(path + ".usuarios", memoria / 3);
+    porCancion = make_unique<PagedBPlusTree<ValoracionPorCancion>>(path + ".canciones", memoria / 3);
+    if (!porValor->is_open() || !porUsuario->is_open() || !porCancion->is_open() || porUsuario->size() != porValor->size() ||
+        porCancion->size() != porValor->size())
+    {
+        porValor.reset();
+        porUsuario.reset();
+        porCancion.reset();
+        return false;
+    }
+    return true;
+}
+
+// Las valoraciones de un id son un tramo del árbol: desde la menor posible con ese id hasta la
+// mayor. Se copian a la lista en el orden del árbol, que es el del otro id
+template <typename Registro>
+static ListaAdyacencia tramo(PagedBPlusTree<Registro> &arbol, uint32_t Valoracion::*clave, uint32_t Valoracion::*otro, uint32_t id,
+                             uint32_t cuantosOtros, CopiaAdyacencia &copia)
+{
+    Registro desde, hasta;
+    desde.v.*clave = id;
+    desde.v.*otro = 0;
+    desde.v.medias = 0;
+    desde.v.tiempo = 0;
+    hasta.v = desde.v;
+    hasta.v.*otro = UINT32_MAX;
+    hasta.v.medias = UINT16_MAX;
+    hasta.v.tiempo = UINT32_MAX;
+
+    copia.ids.clear();
+    copia.medias.clear();
+    copia.tiempos.clear();
+    arbol.range_for_each(desde, hasta, [&](const Registro &r)
+                         {
+        if (r.v.*otro >= cuantosOtros)
+            return;
+        copia.ids.push_back(r.v.*otro);
+        copia.medias.push_back(r.v.medias);
+        copia.tiempos.push_back(r.v.tiempo); });
+    return {copia.ids.data(), copia.medias.data(), copia.tiempos.data(), copia.ids.size()};
+}
+
+ListaAdyacencia IndicePaginado::canciones(uint32_t usuario, CopiaAdyacencia &copia) const
+{
+    if (!porUsuario || usuario >= cuantosUsuarios)
+        return {nullptr, nullptr, nullptr, 0};
+    return tramo(*porUsuario, &Valoracion::usuario, &Valoracion::cancion, usuario, cuantasCanciones, copia);
+}
+
+ListaAdyacencia IndicePaginado::usuarios(uint32_t cancion, CopiaAdyacencia &copia) const
+{
+    if (!porCancion || cancion >= cuantasCanciones)
+        return {nullptr, nullptr, nullptr, 0};
+    return tramo(*porCancion, &Valoracion::cancion, &Valoracion::usuario, cancion, cuantosUsuarios, copia);
+}
+
+// Ordena registros y los escribe en un árbol nuevo en path, de abajo hacia arriba
+template <typename Registro>
+static bool escribirArbol(const string &path, vector<Registro> &registros)
+{
+    parallel_stable_sort(registros.begin(), registros.end());
+    // Se escribe de nuevo aunque ya exista, con otro tamaño de página o de registro
+    ::unlink(path.c_str());
+    PagedBPlusTree<Registro> arbol(path);
+    if (!arbol.is_open())
+        return false;
+    arbol.bulk_load(registros.begin(), registros.end());
+    return arbol.close();
+}
+
+bool guardarIdx(const string &path, const AlmacenValoraciones &almacen, const CodigosValoraciones &codigos)
+{
+    vector<Valoracion> filas;
+    filas.reserve(almacen.live_size());
+    for (uint32_t fila = 0; fila < almacen.size(); fila++)
+    {
+        if (almacen.live(fila))
+            filas.push_back(almacen[fila]);
+    }
+    vector<ValoracionPorUsuario> porUsuario(filas.size());
+    vector<ValoracionPorCancion> porCancion(filas.size());
+    for (size_t i = 0; i < filas.size(); i++)
+    {
+        porUsuario[i].v = filas[i];
+        porCancion[i].v = filas[i];
+    }
+    if (!escribirArbol(path, filas) || !escribirArbol(path + ".usuarios", porUsuario) || !escribirArbol(path + ".canciones", porCancion))
+        return false;
+
+    EscritorVbin escritor;
+    return escritor.abrir(path + ".codigos", 0) && escritor.cerrar(codigos);
+}
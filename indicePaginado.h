@@ -0,0 +1,91 @@
+#ifndef INDICE_PAGINADO_H
+#define INDICE_PAGINADO_H
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include "PagedBPlusTree.h"
+#include "valoracion.h"
+#include "valoracionAdyacencia.h"
+#include "valoracionIndices.h"
+
+using namespace std;
+
+// Valoracion en orden de un id y luego del otro, con el valor y el tiempo para desempatar: las
+// valoraciones de un usuario (o de una canción) quedan juntas y en orden del otro id, como en
+// las listas de adyacencia. Es trivialmente copiable, así que PageRecord guarda sus bytes.
+template <uint32_t Valoracion::*primero, uint32_t Valoracion::*segundo>
+struct ValoracionPor
+{
+    Valoracion v;
+
+    bool operator<(const ValoracionPor &otra) const
+    {
+        return tie(v.*primero, v.*segundo, v.medias, v.tiempo) < tie(otra.v.*primero, otra.v.*segundo, otra.v.medias, otra.v.tiempo);
+    }
+    bool operator<=(const ValoracionPor &otra) const { return !(otra < *this); }
+    bool operator==(const ValoracionPor &otra) const { return !(*this < otra) && !(otra < *this); }
+};
+
+typedef ValoracionPor<&Valoracion::usuario, &Valoracion::cancion> ValoracionPorUsuario;
+typedef ValoracionPor<&Valoracion::cancion, &Valoracion::usuario> ValoracionPorCancion;
+
+// Índice paginado (.idx): las filas vivas en tres PagedBPlusTree, en orden de Valoracion en
+// <path>, por usuario en <path>.usuarios y por canción en <path>.canciones, y sus códigos en
+// <path>.codigos, un .vbin sin filas. Abrirlo solo lee los códigos: cada consulta lee las
+// páginas que recorre a través del búfer de su árbol, así que las filas nunca están todas en
+// memoria. Es de solo lectura; las filas con ids fuera de los códigos se saltan.
+class IndicePaginado : public FuenteAdyacencia
+{
+    unique_ptr<PagedBPlusTree<Valoracion>> porValor;
+    unique_ptr<PagedBPlusTree<ValoracionPorUsuario>> porUsuario;
+    unique_ptr<PagedBPlusTree<ValoracionPorCancion>> porCancion;
+    uint32_t cuantosUsuarios; // tamaño de los diccionarios de códigos
+    uint32_t cuantasCanciones;
+
+    bool valida(const Valoracion &v) const { return v.usuario < cuantosUsuarios && v.cancion < cuantasCanciones; }
+
+public:
+    IndicePaginado();
+
+    // Llena codigos, que deben estar vacíos. Los tres árboles guardan a lo sumo memoria bytes
+    // de páginas entre todos. False si falta algún archivo, no es de este formato o los árboles
+    // no tienen las mismas filas.
+    bool abrir(const string &path, CodigosValoraciones &codigos, size_t memoria = 192 << 20);
+
+    uint64_t filas() const { return porValor ? porValor->size() : 0; }
+
+    ListaAdyacencia canciones(uint32_t usuario, CopiaAdyacencia &copia) const override;
+    ListaAdyacencia usuarios(uint32_t cancion, CopiaAdyacencia &copia) const override;
+
+    // Llama a f con cada valoración de valor entre desde y hasta, en orden de Valoracion
+    template <typename Funcion>
+    void recorrerValores(float desde, float hasta, Funcion f) const
+    {
+        if (!porValor)
+            return;
+        Valoracion inicio(0, 0, desde); // antes que cualquier valoración con ese valor
+        Valoracion fin(StringDictionary::NONE, StringDictionary::NONE, hasta);
+        porValor->range_for_each(inicio, fin, [&](const Valoracion &v)
+                                 {
+            if (valida(v))
+                f(v); });
+    }
+    // Llama a f con todas las valoraciones, en orden de Valoracion
+    template <typename Funcion>
+    void recorrer(Funcion f) const
+    {
+        if (!porValor)
+            return;
+        porValor->for_each([&](const Valoracion &v)
+                           {
+            if (valida(v))
+                f(v); });
+    }
+};
+
+// Escribe los cuatro archivos del índice paginado con las filas vivas de almacen. False si
+// alguno no se pudo escribir.
+bool guardarIdx(const string &path, const AlmacenValoraciones &almacen, const CodigosValoraciones &codigos);
+
+#endif // INDICE_PAGINADO_H
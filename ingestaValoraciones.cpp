@@ -0,0 +1,165 @@
+#include "ingestaValoraciones.h"
+#include "lectorCSV.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+IngestaValoraciones::IngestaValoraciones(AlmacenValoraciones &_almacen, CodigosValoraciones &_codigos, IndicePorUsuario &_porUsuario, shared_mutex &_cerrojo)
+    : almacen(&_almacen), codigos(&_codigos), porUsuario(&_porUsuario), cerrojo(&_cerrojo), detener(false),
+      agregadas(0), actualizadas(0), descartadas(0) {}
+
+IngestaValoraciones::~IngestaValoraciones()
+{
+    dejarDeSeguir();
+}
+
+size_t IngestaValoraciones::aplicar(const char *p, const char *fin)
+{
+    // Se separan los campos antes de tomar el cerrojo
+    struct Fila
+    {
+        string_view usuario, cancion;
+        float valor;
+        uint32_t tiempo;
+    };
+    vector<Fila> filas;
+    while (p < fin)
+    {
+        const char *finLinea = static_cast<const char *>(memchr(p, '\n', fin - p));
+        if (finLinea == nullptr)
+            finLinea = fin;
+        const char *finTexto = finLinea > p && finLinea[-1] == '\r' ? finLinea - 1 : finLinea;
+        Fila fila;
+        if (finTexto > p && separarFila(p, finTexto, fila.usuario, fila.cancion, fila.valor, fila.tiempo))
+            filas.push_back(fila);
+        else if (finTexto > p)
+            descartadas++;
+        p = finLinea + 1;
+    }
+    if (filas.empty())
+        return 0;
+
+    unique_lock<shared_mutex> escritura(*cerrojo);
+    // Dentro del lote vale la última valoración de cada par
+    unordered_map<uint64_t, Valoracion> ultimas;
+    vector<uint64_t> orden;
+    for (const Fila &fila : filas)
+    {
+        Valoracion v(codigos->usuarios.intern(fila.usuario), codigos->canciones.intern(fila.cancion), fila.valor, fila.tiempo);
+        uint64_t par = uint64_t(v.usuario) << 32 | v.cancion;
+        if (ultimas.insert_or_assign(par, v).second)
+            orden.push_back(par);
+    }
+
+    vector<Valoracion> nuevas;
+    vector<uint32_t> viejas;
+    for (uint64_t par : orden)
+    {
+        const Valoracion &v = ultimas[par];
+        viejas.clear();
+        porUsuario->equal_for_each_row(v.usuario, [&](uint32_t fila)
+                                       {
+            if ((*almacen)[fila].cancion == v.cancion)
+                viejas.push_back(fila); });
+        if (viejas.size() == 1 && (*almacen)[viejas[0]].medias == v.medias && (*almacen)[viejas[0]].tiempo == v.tiempo)
+            continue; // la misma valoración otra vez
+        for (uint32_t fila : viejas)
+            almacen->remove(fila);
+        (viejas.empty() ? agregadas : actualizadas)++;
+        nuevas.push_back(v);
+    }
+    if (!nuevas.empty())
+        almacen->append_batch(move(nuevas));
+    return filas.size();
+}
+
+bool IngestaValoraciones::seguir(const string &path, bool desdeElFinal)
+{
+    if (seguidor.joinable())
+        return false;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (desdeElFinal && lseek(fd, 0, SEEK_END) < 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    detener = false;
+    seguidor = thread(&IngestaValoraciones::seguirArchivo, this, path, fd);
+    return true;
+}
+
+void IngestaValoraciones::dejarDeSeguir()
+{
+    if (!seguidor.joinable())
+        return;
+    detener = true;
+    seguidor.join();
+}
+
+// Lee lo que haya y aplica las líneas completas; al llegar al final espera un milisegundo y
+// vuelve a mirar, así las valoraciones agregadas al archivo se ven a los pocos milisegundos.
+// También al final se mira si el archivo se truncó (es más corto que lo leído) o si path ya es
+// otro archivo (se rotó): en los dos casos se sigue leyendo el de path desde el principio, y la
+// línea incompleta que hubiera quedado se descarta
+void IngestaValoraciones::seguirArchivo(string path, int fd)
+{
+    string pendiente;
+    vector<char> bufer(1 << 16);
+    off_t leido = lseek(fd, 0, SEEK_CUR);
+    while (!detener)
+    {
+        ssize_t leidos = ::read(fd, bufer.data(), bufer.size());
+        if (leidos <= 0)
+        {
+            struct stat abierto, actual;
+            bool truncado = false, rotado = false;
+            if (fstat(fd, &abierto) == 0)
+            {
+                truncado = abierto.st_size < leido;
+                rotado = !truncado && ::stat(path.c_str(), &actual) == 0 &&
+                         (actual.st_ino != abierto.st_ino || actual.st_dev != abierto.st_dev);
+            }
+            int otro = rotado ? ::open(path.c_str(), O_RDONLY) : -1;
+            if (truncado || otro >= 0)
+            {
+                if (otro >= 0)
+                {
+                    ::close(fd);
+                    fd = otro;
+                }
+                else
+                    lseek(fd, 0, SEEK_SET);
+                leido = 0;
+                pendiente.clear();
+                continue;
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
+        leido += leidos;
+        pendiente.append(bufer.data(), leidos);
+        size_t ultimo = pendiente.rfind('\n');
+        if (ultimo == string::npos)
+            continue;
+        try
+        {
+            aplicar(pendiente.data(), pendiente.data() + ultimo + 1);
+        }
+        catch (const exception &e)
+        {
+            cerr << "Error applying new ratings: " << e.what() << endl;
+            break;
+        }
+        pendiente.erase(0, ultimo + 1);
+    }
+    ::close(fd);
+}
@@ -0,0 +1,52 @@
+#ifndef INGESTA_VALORACIONES_H
+#define INGESTA_VALORACIONES_H
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include "valoracion.h"
+#include "valoracionIndices.h"
+
+using namespace std;
+
+// Valoraciones nuevas con el programa en marcha. Cada lote de líneas "usuario,canción,valor[,tiempo]" se
+// aplica al almacén con el cerrojo exclusivo, y los índices y listas que lo siguen se actualizan
+// en el mismo paso; las consultas toman el cerrojo compartido, así que ven cada lote entero o
+// nada. Una valoración de un (usuario, canción) que ya existe la reemplaza: la fila vieja se quita
+// y se agrega la nueva. Los códigos nuevos reciben los ids siguientes, fuera del orden de código.
+class IngestaValoraciones
+{
+    AlmacenValoraciones *almacen;
+    CodigosValoraciones *codigos;
+    IndicePorUsuario *porUsuario;
+    shared_mutex *cerrojo;
+
+    thread seguidor;
+    atomic<bool> detener;
+    atomic<uint64_t> agregadas, actualizadas, descartadas;
+
+    void seguirArchivo(string path, int fd);
+
+public:
+    IngestaValoraciones(AlmacenValoraciones &almacen, CodigosValoraciones &codigos, IndicePorUsuario &porUsuario, shared_mutex &cerrojo);
+    ~IngestaValoraciones();
+    IngestaValoraciones(const IngestaValoraciones &) = delete;
+    IngestaValoraciones &operator=(const IngestaValoraciones &) = delete;
+
+    // Aplica las líneas de [p, fin) como un lote; las mal formadas se cuentan y se saltan.
+    // Devuelve cuántas se aplicaron.
+    size_t aplicar(const char *p, const char *fin);
+
+    // Lee path desde el principio (o desde el final, con desdeElFinal) y después cada línea que se
+    // le agregue, en otro hilo, hasta dejarDeSeguir(). Si el archivo se trunca o se rota, vuelve a
+    // leer el de path desde el principio. False si ya se sigue un archivo o no se puede abrir.
+    bool seguir(const string &path, bool desdeElFinal = false);
+    void dejarDeSeguir();
+
+    uint64_t nuevas() const { return agregadas; }       // valoraciones de pares nuevos
+    uint64_t reemplazos() const { return actualizadas; } // valoraciones que reemplazaron a otra
+    uint64_t malFormadas() const { return descartadas; }
+};
+
+#endif // INGESTA_VALORACIONES_H
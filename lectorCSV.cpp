@@ -0,0 +1,185 @@
+#include "lectorCSV.h"
+#include "Parallel.h"
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Primer c en [p, fin), o fin
+static inline const char *buscar(const char *p, const char *fin, char c)
+{
+    while (p < fin && *p != c)
+        p++;
+    return p;
+}
+
+// Fin de la línea que empieza en p: el '\n' (memchr lo busca con SIMD) o fin
+static inline const char *finDeLinea(const char *p, const char *fin)
+{
+    const char *salto = static_cast<const char *>(memchr(p, '\n', fin - p));
+    return salto != nullptr ? salto : fin;
+}
+
+bool separarFila(const char *p, const char *fin, string_view &usuario, string_view &cancion, float &valor, uint32_t &tiempo)
+{
+    const char *coma1 = buscar(p, fin, ',');
+    const char *coma2 = coma1 < fin ? buscar(coma1 + 1, fin, ',') : fin;
+    if (coma2 == fin)
+        return false;
+    const char *finValor = buscar(coma2 + 1, fin, ',');
+    from_chars_result leido = from_chars(coma2 + 1, finValor, valor);
+    if (leido.ec != errc() || leido.ptr != finValor)
+        return false;
+    tiempo = 0;
+    if (finValor < fin)
+    {
+        const char *finTiempo = buscar(finValor + 1, fin, ','); // el resto de columnas no se usa
+        leido = from_chars(finValor + 1, finTiempo, tiempo);
+        if (leido.ec != errc() || leido.ptr != finTiempo)
+            return false;
+    }
+    usuario = string_view(p, coma1 - p);
+    cancion = string_view(coma1 + 1, coma2 - coma1 - 1);
+    return true;
+}
+
+// Lee las filas de [p, fin), que empieza al principio de una línea
+static void leerFilas(const char *p, const char *fin, CodigosValoraciones &codigos, vector<Valoracion> &valoraciones, LecturaCSV &lectura)
+{
+    // Los volcados suelen venir agrupados por usuario: si se repite el de la fila anterior no se
+    // vuelve a buscar en el diccionario
+    string_view ultimoUsuario;
+    uint32_t idUsuario = StringDictionary::NONE;
+    for (const char *finLinea; p < fin; p = finLinea + 1)
+    {
+        finLinea = finDeLinea(p, fin);
+        const char *finTexto = finLinea;
+        if (finTexto > p && finTexto[-1] == '\r')
+            finTexto--;
+        if (finTexto == p)
+            continue; // línea vacía
+
+        string_view usuario, cancion;
+        float valor;
+        uint32_t tiempo;
+        if (!separarFila(p, finTexto, usuario, cancion, valor, tiempo))
+        {
+            lectura.descartadas++;
+            continue;
+        }
+        if (idUsuario == StringDictionary::NONE || usuario != ultimoUsuario)
+        {
+            idUsuario = codigos.usuarios.intern(usuario);
+            ultimoUsuario = usuario;
+        }
+        valoraciones.emplace_back(idUsuario, codigos.canciones.intern(cancion), valor, tiempo);
+        lectura.filas++;
+    }
+}
+
+// Lo que lee un hilo
+struct TramoCSV
+{
+    CodigosValoraciones codigos;
+    vector<Valoracion> valoraciones;
+    LecturaCSV lectura;
+};
+
+// Ids en destino de todos los códigos de origen, por id de origen
+static vector<uint32_t> unirCodigos(const StringDictionary &origen, StringDictionary &destino)
+{
+    vector<uint32_t> ids(origen.size());
+    for (uint32_t id = 0; id < origen.size(); id++)
+        ids[id] = destino.intern(origen[id]);
+    return ids;
+}
+
+bool leerCSV(const string &path, CodigosValoraciones &codigos, vector<Valoracion> &valoraciones, LecturaCSV &lectura, unsigned hilos)
+{
+    auto inicio = chrono::steady_clock::now();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return false;
+    }
+    lectura = LecturaCSV();
+    lectura.bytes = st.st_size;
+    if (st.st_size == 0)
+    {
+        ::close(fd);
+        return true;
+    }
+    void *mapeo = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapeo == MAP_FAILED)
+        return false;
+    madvise(mapeo, st.st_size, MADV_SEQUENTIAL);
+    const char *base = static_cast<const char *>(mapeo);
+    const char *fin = base + st.st_size;
+
+    // Sin cabecera
+    const char *p = min(fin, finDeLinea(base, fin) + 1);
+
+    // Filas estimadas según las del primer mega, para reservar sin copiar los vectores varias veces
+    const char *muestra = p + min<ptrdiff_t>(fin - p, 1 << 20);
+    size_t lineas = 0;
+    for (const char *q = p; q < muestra; q++)
+        lineas += *q == '\n';
+    double filasPorByte = muestra > p ? double(lineas) / (muestra - p) * 1.05 : 0;
+
+    // Al menos un mega por tramo
+    size_t tramos = min<size_t>(parallel_threads(hilos), max<ptrdiff_t>(1, (fin - p) >> 20));
+    if (tramos == 1)
+    {
+        valoraciones.reserve(valoraciones.size() + size_t(filasPorByte * (fin - p)) + 16);
+        leerFilas(p, fin, codigos, valoraciones, lectura);
+    }
+    else
+    {
+        vector<const char *> limites(tramos + 1, fin);
+        limites[0] = p;
+        for (size_t t = 1; t < tramos; t++)
+            limites[t] = max(limites[t - 1], min(fin, finDeLinea(p + (fin - p) * t / tramos, fin) + 1));
+
+        vector<TramoCSV> leidos(tramos);
+        parallel_run(tramos, [&](size_t t)
+                     {
+            leidos[t].valoraciones.reserve(size_t(filasPorByte * (limites[t + 1] - limites[t])) + 16);
+            leerFilas(limites[t], limites[t + 1], leidos[t].codigos, leidos[t].valoraciones, leidos[t].lectura); });
+
+        // Los diccionarios se unen en orden, solo con los códigos distintos de cada tramo; las
+        // valoraciones se copian a su lugar con los ids nuevos, otra vez un hilo por tramo
+        vector<vector<uint32_t>> usuarios(tramos), canciones(tramos);
+        vector<size_t> desde(tramos + 1, valoraciones.size());
+        for (size_t t = 0; t < tramos; t++)
+        {
+            usuarios[t] = unirCodigos(leidos[t].codigos.usuarios, codigos.usuarios);
+            canciones[t] = unirCodigos(leidos[t].codigos.canciones, codigos.canciones);
+            desde[t + 1] = desde[t] + leidos[t].valoraciones.size();
+            lectura.filas += leidos[t].lectura.filas;
+            lectura.descartadas += leidos[t].lectura.descartadas;
+        }
+        valoraciones.resize(desde[tramos]);
+        parallel_run(tramos, [&](size_t t)
+                     {
+            Valoracion *destino = valoraciones.data() + desde[t];
+            for (Valoracion v : leidos[t].valoraciones)
+            {
+                v.usuario = usuarios[t][v.usuario];
+                v.cancion = canciones[t][v.cancion];
+                *destino++ = v;
+            }
+            vector<Valoracion>().swap(leidos[t].valoraciones); });
+    }
+    munmap(mapeo, st.st_size);
+    lectura.segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+    return true;
+}
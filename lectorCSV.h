@@ -0,0 +1,38 @@
+#ifndef LECTOR_CSV_H
+#define LECTOR_CSV_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "valoracion.h"
+
+using namespace std;
+
+// Cifras de una lectura, para informar el rendimiento de la carga
+struct LecturaCSV
+{
+    uint64_t filas = 0;       // valoraciones leídas
+    uint64_t descartadas = 0; // filas mal formadas, que se saltan
+    uint64_t bytes = 0;       // tamaño del archivo
+    double segundos = 0;
+
+    double filasPorSegundo() const { return segundos > 0 ? filas / segundos : 0; }
+    double bytesPorSegundo() const { return segundos > 0 ? bytes / segundos : 0; }
+};
+
+// Lee un CSV de valoraciones (usuario,canción,valor[,tiempo,...]) con mmap, sin copiar las
+// líneas: los códigos se internan directamente desde el archivo y el valor y el tiempo se leen
+// con from_chars. La primera línea es la cabecera. Una fila sin los tres campos, o con un valor o
+// un tiempo que no es un número, se descarta y se cuenta, sin excepciones. Las valoraciones se
+// agregan a valoraciones con los ids de codigos. False si el archivo no se puede abrir.
+//
+// El archivo se reparte en tramos que terminan en fin de línea, uno por hilo (0: uno por núcleo),
+// y cada hilo lee el suyo con un diccionario propio. Después los diccionarios se unen en orden
+// de tramo, así que los ids son los mismos que con una lectura secuencial.
+bool leerCSV(const string &path, CodigosValoraciones &codigos, vector<Valoracion> &valoraciones, LecturaCSV &lectura, unsigned hilos = 0);
+
+// Los campos de una línea [p, fin) del CSV, sin el fin de línea; tiempo es 0 si la línea no
+// tiene la cuarta columna. False si está mal formada.
+bool separarFila(const char *p, const char *fin, string_view &usuario, string_view &cancion, float &valor, uint32_t &tiempo);
+
+#endif // LECTOR_CSV_H
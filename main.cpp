@@ -1,21 +1,76 @@
 #include <iostream>
 #include "BPlusTree.h"
 #include "valoracion.h"
-#include "valoracionPorUsuario.h"
-#include "valoracionPorCancion.h"
-#include <fstream>
+#include "valoracionIndices.h"
+#include "snapshot.h"
+#include "valoracionAdyacencia.h"
+#include "valoracionAgregados.h"
+#include "lectorCSV.h"
+#include "archivoValoraciones.h"
+#include "indicePaginado.h"
+#include "ingestaValoraciones.h"
+#include "Parallel.h"
 #include <unordered_map>
 #include <vector>
 #include <algorithm>
 #include <cmath>
 #include <map>
+#include <chrono>
+#include <memory>
+#include <shared_mutex>
 
 using namespace std;
 
-void topNSongs(int n, BPlusTree<Valoracion> &tree, Valoracion *results, float minValue = 0.0f, float maxValue = 5.0f);
-void topPUsersNearKUser(string kUser, int p, BPlusTree<ValoracionPtrPorUsuario> &treePorUsuario, BPlusTree<ValoracionPtrPorCancion> &treePorCancion, string *resultUsers = nullptr);
-void topNSongsWithoutCustomVal(int n, BPlusTree<Valoracion> &tree, Valoracion *resultSongs, float minValue, float maxValue);
-void recommendNSongsToKUser(int n, string kUser, BPlusTree<ValoracionPtrPorUsuario> &treePorUsuario, BPlusTree<ValoracionPtrPorCancion> &treePorCancion);
+// Grado de los índices. La opción 6 del menú muestra en JSON cómo quedan.
+const size_t GRADO_INDICES = 50;
+
+// Resultado de una consulta: la canción y su puntaje, que ya no es una valoración sino una suma
+struct PuntajeCancion
+{
+    uint32_t cancion = StringDictionary::NONE;
+    float puntaje = 0.0f;
+};
+
+// Ventana de tiempo de las consultas 1, 2 y 4 (opción 10 del menú). Las valoraciones fuera de
+// [desde, hasta] no cuentan, y con vida media el puntaje de cada una se multiplica por
+// 0.5^((referencia - tiempo) / vidaMedia): la de hace una vida media vale la mitad.
+struct VentanaTiempo
+{
+    uint32_t desde = 0;
+    uint32_t hasta = UINT32_MAX;
+    double vidaMedia = 0;    // segundos; 0 sin decaimiento
+    uint32_t referencia = 0; // el tiempo más reciente de la ventana al configurarla
+
+    bool todas() const { return desde == 0 && hasta == UINT32_MAX; }
+    bool contiene(uint32_t tiempo) const { return desde <= tiempo && tiempo <= hasta; }
+    float peso(uint32_t tiempo) const
+    {
+        if (vidaMedia <= 0 || tiempo >= referencia)
+            return 1.0f;
+        return static_cast<float>(exp2(-double(referencia - tiempo) / vidaMedia));
+    }
+};
+
+void topNSongs(int n, IndicePorValor &tree, IndicePorTiempo &porTiempo, const AgregadosCanciones &agregados, PuntajeCancion *results,
+               float minValue = 0.0f, float maxValue = 5.0f, const VentanaTiempo &ventana = VentanaTiempo());
+void topNSongs(int n, const IndicePaginado &indice, PuntajeCancion *results, float minValue = 0.0f, float maxValue = 5.0f,
+               const VentanaTiempo &ventana = VentanaTiempo());
+void topPUsersNearKUser(uint32_t kUser, int p, const FuenteAdyacencia &adyacencia, uint32_t *resultUsers = nullptr);
+void topNSongsWithoutCustomVal(int n, const ListaAdyacencia &canciones, PuntajeCancion *resultSongs, float minValue, float maxValue,
+                               const VentanaTiempo &ventana = VentanaTiempo());
+void recommendNSongsToKUser(int n, const string &kUser, const FuenteAdyacencia &adyacencia, const CodigosValoraciones &codigos,
+                            const VentanaTiempo &ventana = VentanaTiempo());
+bool loadCSV(const string &fileName, AlmacenValoraciones &almacen, CodigosValoraciones &codigos);
+bool loadVbin(const string &fileName, AlmacenValoraciones &almacen, CodigosValoraciones &codigos);
+int consultarIdx(const string &fileName, chrono::steady_clock::time_point inicio);
+void ordenarValoraciones(CodigosValoraciones &codigos, vector<Valoracion> &valoraciones);
+
+// Los resultados llevan ids; el código solo se busca para mostrarlo ("" si no hay resultado)
+const string &codigo(const StringDictionary &diccionario, uint32_t id)
+{
+    static const string vacio;
+    return id == StringDictionary::NONE ? vacio : diccionario[id];
+}
 
 int mainMenu()
 {
@@ -26,6 +81,13 @@ int mainMenu()
     cout << "3. Encontrar usuarios similares a un usuario (Top P vecinos)" << endl;
     cout << "4. Recomendar N canciones a un usuario" << endl;
     cout << "5. Salir" << endl;
+    cout << "6. Mostrar estadísticas de los índices (JSON)" << endl;
+    cout << "7. Guardar las valoraciones en formato binario (.vbin)" << endl;
+    cout << "8. Agregar valoraciones" << endl;
+    cout << "9. Seguir un archivo de valoraciones nuevas" << endl;
+    cout << "10. Ventana de tiempo y vida media de las consultas 1, 2 y 4" << endl;
+    cout << "11. Guardar las valoraciones en un índice paginado (.idx)" << endl;
+    cout << "12. Guardar un snapshot de las valoraciones y los índices (.snap)" << endl;
     cout << "Seleccione una opción: ";
     cin >> opcion;
     return opcion;
@@ -33,46 +95,84 @@ int mainMenu()
 
 int main()
 {
-    BPlusTree<Valoracion> tree(50);
-    BPlusTree<ValoracionPtrPorUsuario> treePorUsuario(50);
-    BPlusTree<ValoracionPtrPorCancion> treePorCancion(50);
+    AlmacenValoraciones almacen;
+    CodigosValoraciones codigos;
 
     string n;
     cout << "Ingrese el nombre del archivo: ";
     cin >> n;
-    ifstream file(n);
-    if (!file.is_open())
+
+    // Un archivo .snap se abre con mmap; un .vbin también y un CSV se lee. Un .idx no se carga:
+    // sus consultas leen las páginas que necesitan (consultarIdx). El snapshot solo se guarda si
+    // se pide (opción 12)
+    auto inicio = chrono::steady_clock::now();
+    auto terminaEn = [&n](const string &extension)
+    { return n.size() > extension.size() && n.compare(n.size() - extension.size(), extension.size(), extension) == 0; };
+    bool esSnapshot = terminaEn(".snap");
+    Snapshot snapshot;
+    if (esSnapshot)
     {
-        cerr << "Error opening file." << endl;
-        return 1;
+        if (!snapshot.abrir(n) || !snapshot.cargar(almacen, codigos))
+        {
+            cerr << "Error opening snapshot." << endl;
+            return 1;
+        }
     }
-    string line;
-    getline(file, line);
-
-    while (getline(file, line))
+    else if (terminaEn(".vbin"))
     {
-        string usuario, cancion;
-        float valor;
-        size_t pos1 = line.find(',');
-        size_t pos2 = line.find(',', pos1 + 1);
-
-        if (pos1 != string::npos && pos2 != string::npos)
+        if (!loadVbin(n, almacen, codigos))
         {
-            usuario = line.substr(0, pos1);
-            cancion = line.substr(pos1 + 1, pos2 - pos1 - 1);
-            valor = stof(line.substr(pos2 + 1));
-            Valoracion v(usuario, cancion, valor);
-            tree.insert(v);
+            cerr << "Error opening binary file." << endl;
+            return 1;
         }
     }
-    file.close();
-
-    tree.for_each([&treePorUsuario, &treePorCancion](Valoracion &v)
-                  {
-        ValoracionPtrPorUsuario valoracionPorUsuario(v.codigoUsuario, &v);
-        ValoracionPtrPorCancion valoracionPorCancion(v.codigoCancion, &v);
-        treePorUsuario.insert(valoracionPorUsuario);
-        treePorCancion.insert(valoracionPorCancion); });
+    else if (terminaEn(".idx"))
+        return consultarIdx(n, inicio);
+    else if (!loadCSV(n, almacen, codigos))
+    {
+        cerr << "Error opening file." << endl;
+        return 1;
+    }
+
+    // Los índices ordenan las filas del almacén; el snapshot ya trae ese orden. Las consultas por
+    // usuario y por canción leen tramos contiguos de las listas de adyacencia, y el Top N global
+    // los totales por canción. Los seis se construyen a la vez, y cada índice ordena con un
+    // cuarto de los núcleos
+    unique_ptr<IndicePorValor> porValor;
+    unique_ptr<IndicePorUsuario> porUsuario;
+    unique_ptr<IndicePorCancion> porCancion;
+    unique_ptr<IndicePorTiempo> porTiempo;
+    unique_ptr<AdyacenciaValoraciones> listas;
+    unique_ptr<AgregadosCanciones> agregados;
+    unsigned hilosPorIndice = max(1u, parallel_threads() / 4);
+    parallel_run(6, [&](size_t tarea)
+                 {
+        if (tarea == 0)
+            porValor = make_unique<IndicePorValor>(almacen, esSnapshot ? snapshot.porValor() : nullptr, GRADO_INDICES, hilosPorIndice);
+        else if (tarea == 1)
+            porUsuario = make_unique<IndicePorUsuario>(almacen, esSnapshot ? snapshot.porUsuario() : nullptr, GRADO_INDICES, hilosPorIndice);
+        else if (tarea == 2)
+            porCancion = make_unique<IndicePorCancion>(almacen, esSnapshot ? snapshot.porCancion() : nullptr, GRADO_INDICES, hilosPorIndice);
+        else if (tarea == 3)
+            porTiempo = make_unique<IndicePorTiempo>(almacen, esSnapshot ? snapshot.porTiempo() : nullptr, GRADO_INDICES, hilosPorIndice);
+        else if (tarea == 4)
+            listas = make_unique<AdyacenciaValoraciones>(almacen, codigos.usuarios.size(), codigos.canciones.size());
+        else
+            agregados = make_unique<AgregadosCanciones>(almacen, codigos.canciones.size()); });
+    snapshot.cerrar();
+    IndicePorValor &tree = *porValor;
+    IndicePorUsuario &treePorUsuario = *porUsuario;
+    IndicePorCancion &treePorCancion = *porCancion;
+    IndicePorTiempo &treePorTiempo = *porTiempo;
+    const AdyacenciaValoraciones &adyacencia = *listas;
+    const AgregadosCanciones &totales = *agregados;
+    // Las valoraciones nuevas se aplican con el cerrojo exclusivo; cada consulta toma el compartido
+    shared_mutex cerrojo;
+    IngestaValoraciones ingesta(almacen, codigos, treePorUsuario, cerrojo);
+    VentanaTiempo ventana;
+    auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - inicio).count();
+    cout << "Tiempo de carga: " << ms << " ms" << endl;
+
     int opcion;
     do
     {
@@ -84,13 +184,14 @@ int main()
             int n;
             cout << "Ingrese el número de canciones a mostrar (Top N): ";
             cin >> n;
-            Valoracion *resultSongs = new Valoracion[n];
-            topNSongs(n, tree, resultSongs, 4.5f, 5.0f);
+            shared_lock<shared_mutex> lectura(cerrojo);
+            PuntajeCancion *resultSongs = new PuntajeCancion[n];
+            topNSongs(n, tree, treePorTiempo, totales, resultSongs, 4.5f, 5.0f, ventana);
             cout << "Top " << n << " canciones globales:" << endl;
             for (int i = 0; i < n; ++i)
             {
-                if (!resultSongs[i].codigoCancion.empty())
-                    cout << "Canción: " << resultSongs[i].codigoCancion << ", Valor: " << resultSongs[i].valor << endl;
+                if (resultSongs[i].cancion != StringDictionary::NONE)
+                    cout << "Canción: " << codigo(codigos.canciones, resultSongs[i].cancion) << ", Valor: " << resultSongs[i].puntaje << endl;
             }
             delete[] resultSongs;
             break;
@@ -104,25 +205,15 @@ int main()
             cout << "Ingrese el número de canciones a mostrar (Top N): ";
             cin >> n;
 
-            ValoracionPtrPorUsuario start(usuario, nullptr);
-            ValoracionPtrPorUsuario end(usuario, nullptr);
-            ValoracionPtrPorUsuario *results = new ValoracionPtrPorUsuario[100000];
-            int count = treePorUsuario.range_search(start, end, results, 100000);
-
-            BPlusTree<Valoracion> songsUsuario(100);
-            for (int i = 0; i < count; i++)
-            {
-                songsUsuario.insert(*results[i].ptr);
-            }
-            delete[] results;
-
-            Valoracion *resultSongs = new Valoracion[n];
-            topNSongsWithoutCustomVal(n, songsUsuario, resultSongs, 0.0f, 5.0f);
+            shared_lock<shared_mutex> lectura(cerrojo);
+            PuntajeCancion *resultSongs = new PuntajeCancion[n];
+            CopiaAdyacencia copia;
+            topNSongsWithoutCustomVal(n, adyacencia.canciones(codigos.usuarios.find(usuario), copia), resultSongs, 0.0f, 5.0f, ventana);
             cout << "Top " << n << " canciones del usuario " << usuario << ":" << endl;
             for (int i = 0; i < n; ++i)
             {
-                if (!resultSongs[i].codigoCancion.empty())
-                    cout << "Canción: " << resultSongs[i].codigoCancion << ", Valor: " << resultSongs[i].valor << endl;
+                if (resultSongs[i].cancion != StringDictionary::NONE)
+                    cout << "Canción: " << codigo(codigos.canciones, resultSongs[i].cancion) << ", Valor: " << resultSongs[i].puntaje << endl;
             }
             delete[] resultSongs;
             break;
@@ -136,12 +227,14 @@ int main()
             cout << "Ingrese el número de usuarios similares a mostrar (Top P): ";
             cin >> p;
 
+            shared_lock<shared_mutex> lectura(cerrojo);
             cout << "Las " << p << " valoraciones mas cercanas al usuario " << kUser << ":" << endl;
-            string *nearestUsers = new string[p];
-            topPUsersNearKUser(kUser, p, treePorUsuario, treePorCancion, nearestUsers);
+            uint32_t *nearestUsers = new uint32_t[p];
+            fill(nearestUsers, nearestUsers + p, StringDictionary::NONE);
+            topPUsersNearKUser(codigos.usuarios.find(kUser), p, adyacencia, nearestUsers);
             for (int i = 0; i < p; ++i)
             {
-                cout << nearestUsers[i] << endl;
+                cout << codigo(codigos.usuarios, nearestUsers[i]) << endl;
             }
             break;
         }
@@ -153,12 +246,115 @@ int main()
             cin >> usuario;
             cout << "¿Cuántas canciones recomendar? ";
             cin >> n;
-            recommendNSongsToKUser(n, usuario, treePorUsuario, treePorCancion);
+            shared_lock<shared_mutex> lectura(cerrojo);
+            recommendNSongsToKUser(n, usuario, adyacencia, codigos, ventana);
             break;
         }
         case 5:
             cout << "Saliendo del programa." << endl;
             break;
+        case 6:
+        {
+            shared_lock<shared_mutex> lectura(cerrojo);
+            cout << "{\"porValor\": ";
+            tree.write_json(cout);
+            cout << ", \"porUsuario\": ";
+            treePorUsuario.write_json(cout);
+            cout << ", \"porCancion\": ";
+            treePorCancion.write_json(cout);
+            cout << ", \"porTiempo\": ";
+            treePorTiempo.write_json(cout);
+            cout << "}" << endl;
+            break;
+        }
+        case 7:
+        {
+            string destino;
+            cout << "Ingrese el nombre del archivo .vbin: ";
+            cin >> destino;
+            shared_lock<shared_mutex> lectura(cerrojo);
+            if (guardarVbin(destino, almacen, codigos))
+                cout << "Valoraciones guardadas en " << destino << endl;
+            else
+                cout << "No se pudo escribir " << destino << endl;
+            break;
+        }
+        case 8:
+        {
+            // Una valoración por línea hasta una línea vacía; cada línea se aplica al leerla
+            cout << "Ingrese valoraciones usuario,canción,valor[,tiempo] (línea vacía para terminar):" << endl;
+            string linea;
+            getline(cin, linea);
+            size_t aplicadas = 0;
+            while (getline(cin, linea) && !linea.empty())
+            {
+                linea += '\n';
+                aplicadas += ingesta.aplicar(linea.data(), linea.data() + linea.size());
+            }
+            cout << aplicadas << " valoraciones aplicadas (" << ingesta.nuevas() << " nuevas, " << ingesta.reemplazos()
+                 << " reemplazos, " << ingesta.malFormadas() << " mal formadas en total)" << endl;
+            break;
+        }
+        case 9:
+        {
+            string origen, desde;
+            cout << "Ingrese el archivo a seguir: ";
+            cin >> origen;
+            cout << "¿Leer las valoraciones que ya tiene (s) o solo las que se agreguen (n)? ";
+            cin >> desde;
+            if (ingesta.seguir(origen, desde == "n"))
+                cout << "Siguiendo " << origen << endl;
+            else
+                cout << "No se pudo seguir " << origen << endl;
+            break;
+        }
+        case 10:
+        {
+            uint32_t desde, hasta;
+            double dias;
+            cout << "Ingrese el inicio y el fin de la ventana en segundos desde 1970 (0 0 para todas): ";
+            cin >> desde >> hasta;
+            cout << "Ingrese la vida media en días (0 sin decaimiento): ";
+            cin >> dias;
+            ventana = VentanaTiempo();
+            ventana.desde = desde;
+            ventana.hasta = hasta == 0 ? UINT32_MAX : hasta;
+            ventana.vidaMedia = max(0.0, dias) * 86400;
+            // La referencia del decaimiento es la valoración más reciente de la ventana
+            shared_lock<shared_mutex> lectura(cerrojo);
+            ventana.referencia = treePorTiempo.parallel_range_reduce(
+                ventana.desde, ventana.hasta, ventana.desde, [](uint32_t &masReciente, const Valoracion &v)
+                { masReciente = max(masReciente, v.tiempo); }, [](uint32_t &masReciente, const uint32_t &parte)
+                { masReciente = max(masReciente, parte); });
+            cout << "Ventana [" << ventana.desde << ", " << ventana.hasta << "], referencia " << ventana.referencia
+                 << ", vida media " << max(0.0, dias) << " días" << endl;
+            break;
+        }
+        case 11:
+        {
+            string destino;
+            cout << "Ingrese el nombre del archivo .idx: ";
+            cin >> destino;
+            shared_lock<shared_mutex> lectura(cerrojo);
+            if (guardarIdx(destino, almacen, codigos))
+                cout << "Valoraciones guardadas en " << destino << ", " << destino << ".usuarios, " << destino << ".canciones y "
+                     << destino << ".codigos" << endl;
+            else
+                cout << "No se pudo escribir " << destino << endl;
+            break;
+        }
+        case 12:
+        {
+            string destino;
+            cout << "Ingrese el nombre del archivo .snap: ";
+            cin >> destino;
+            shared_lock<shared_mutex> lectura(cerrojo);
+            if (Snapshot::guardar(destino, almacen, codigos, tree, treePorUsuario, treePorCancion, treePorTiempo))
+                cout << "Snapshot guardado en " << destino << endl;
+            else
+                cout << "No se pudo escribir " << destino << endl;
+            break;
+        }
         default:
             cout << "Opción inválida." << endl;
             break;
@@ -166,79 +362,218 @@ int main()
     } while (opcion != 5);
 }
 
-void topPUsersNearKUser(string kUser, int p, BPlusTree<ValoracionPtrPorUsuario> &treePorUsuario, BPlusTree<ValoracionPtrPorCancion> &treePorCancion, string *resultUsers)
+bool loadCSV(const string &fileName, AlmacenValoraciones &almacen, CodigosValoraciones &codigos)
 {
-    ValoracionPtrPorUsuario start(kUser, nullptr);
-    ValoracionPtrPorUsuario end(kUser, nullptr);
-
-    ValoracionPtrPorUsuario *results = new ValoracionPtrPorUsuario[100000];
-    int count = treePorUsuario.range_search(start, end, results, 100000);
+    vector<Valoracion> valoraciones;
+    LecturaCSV lectura;
+    if (!leerCSV(fileName, codigos, valoraciones, lectura))
+        return false;
+    cout << "Leídas " << lectura.filas << " filas en " << lectura.segundos * 1000 << " ms ("
+         << lectura.filasPorSegundo() / 1e6 << " M filas/s, " << lectura.bytesPorSegundo() / 1e6 << " MB/s)";
+    if (lectura.descartadas > 0)
+        cout << ", " << lectura.descartadas << " filas mal formadas descartadas";
+    cout << endl;
+
+    ordenarValoraciones(codigos, valoraciones);
+    almacen.append_batch(move(valoraciones));
+    return true;
+}
 
-    BPlusTree<Valoracion> songs(3);
+bool loadVbin(const string &fileName, AlmacenValoraciones &almacen, CodigosValoraciones &codigos)
+{
+    LectorVbin lector;
+    vector<Valoracion> valoraciones;
+    if (!lector.abrir(fileName) || !lector.cargar(codigos, valoraciones))
+        return false;
+    if (!(lector.flags() & VBIN_ORDENADO))
+        ordenarValoraciones(codigos, valoraciones);
+    almacen.append_batch(move(valoraciones));
+    return true;
+}
 
-    for (int i = 0; i < count; i++)
+// Las consultas 1 a 4 y la ventana de tiempo sobre un índice paginado: las listas de usuarios y
+// canciones y el recorrido por valor salen de sus árboles página a página, así que las filas no
+// se cargan. Las demás opciones necesitan el almacén y no están disponibles.
+int consultarIdx(const string &fileName, chrono::steady_clock::time_point inicio)
+{
+    CodigosValoraciones codigos;
+    IndicePaginado indice;
+    if (!indice.abrir(fileName, codigos))
     {
-        ValoracionPtrPorUsuario current = results[i];
-        Valoracion *v = current.ptr;
-        songs.insert(*v);
+        cerr << "Error opening index file." << endl;
+        return 1;
     }
+    VentanaTiempo ventana;
+    auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - inicio).count();
+    cout << "Tiempo de carga: " << ms << " ms" << endl;
 
-    delete[] results;
+    int opcion;
+    do
+    {
+        opcion = mainMenu();
+        switch (opcion)
+        {
+        case 1:
+        case 2:
+        {
+            string usuario;
+            int n;
+            if (opcion == 2)
+            {
+                cout << "Ingrese el código del usuario: ";
+                cin >> usuario;
+            }
+            cout << "Ingrese el número de canciones a mostrar (Top N): ";
+            cin >> n;
+            PuntajeCancion *resultSongs = new PuntajeCancion[n];
+            if (opcion == 1)
+            {
+                topNSongs(n, indice, resultSongs, 4.5f, 5.0f, ventana);
+                cout << "Top " << n << " canciones globales:" << endl;
+            }
+            else
+            {
+                CopiaAdyacencia copia;
+                topNSongsWithoutCustomVal(n, indice.canciones(codigos.usuarios.find(usuario), copia), resultSongs, 0.0f, 5.0f, ventana);
+                cout << "Top " << n << " canciones del usuario " << usuario << ":" << endl;
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                if (resultSongs[i].cancion != StringDictionary::NONE)
+                    cout << "Canción: " << codigo(codigos.canciones, resultSongs[i].cancion) << ", Valor: " << resultSongs[i].puntaje << endl;
+            }
+            delete[] resultSongs;
+            break;
+        }
+        case 3:
+        {
+            string kUser;
+            int p;
+            cout << "Ingrese el código del usuario de referencia (kUser): ";
+            cin >> kUser;
+            cout << "Ingrese el número de usuarios similares a mostrar (Top P): ";
+            cin >> p;
+            cout << "Las " << p << " valoraciones mas cercanas al usuario " << kUser << ":" << endl;
+            uint32_t *nearestUsers = new uint32_t[p];
+            fill(nearestUsers, nearestUsers + p, StringDictionary::NONE);
+            topPUsersNearKUser(codigos.usuarios.find(kUser), p, indice, nearestUsers);
+            for (int i = 0; i < p; ++i)
+            {
+                cout << codigo(codigos.usuarios, nearestUsers[i]) << endl;
+            }
+            delete[] nearestUsers;
+            break;
+        }
+        case 4:
+        {
+            string usuario;
+            int n;
+            cout << "Ingrese el código del usuario: ";
+            cin >> usuario;
+            cout << "¿Cuántas canciones recomendar? ";
+            cin >> n;
+            recommendNSongsToKUser(n, usuario, indice, codigos, ventana);
+            break;
+        }
+        case 5:
+            cout << "Saliendo del programa." << endl;
+            break;
+        case 10:
+        {
+            uint32_t desde, hasta;
+            double dias;
+            cout << "Ingrese el inicio y el fin de la ventana en segundos desde 1970 (0 0 para todas): ";
+            cin >> desde >> hasta;
+            cout << "Ingrese la vida media en días (0 sin decaimiento): ";
+            cin >> dias;
+            ventana = VentanaTiempo();
+            ventana.desde = desde;
+            ventana.hasta = hasta == 0 ? UINT32_MAX : hasta;
+            ventana.vidaMedia = max(0.0, dias) * 86400;
+            // Sin índice por tiempo, la referencia sale de recorrer todo el índice
+            ventana.referencia = ventana.desde;
+            indice.recorrer([&ventana](const Valoracion &v)
+                            {
+                if (ventana.contiene(v.tiempo))
+                    ventana.referencia = max(ventana.referencia, v.tiempo); });
+            cout << "Ventana [" << ventana.desde << ", " << ventana.hasta << "], referencia " << ventana.referencia
+                 << ", vida media " << max(0.0, dias) << " días" << endl;
+            break;
+        }
+        case 6:
+        case 7:
+        case 8:
+        case 9:
+        case 11:
+        case 12:
+            cout << "Opción no disponible con un índice paginado." << endl;
+            break;
+        default:
+            cout << "Opción inválida." << endl;
+            break;
+        }
+    } while (opcion != 5);
+    return 0;
+}
 
-    int numSongs = 2;
+// Deja los ids en orden de código y las valoraciones en el orden del almacén
+void ordenarValoraciones(CodigosValoraciones &codigos, vector<Valoracion> &valoraciones)
+{
+    // Los ids pasan a seguir el orden de los códigos
+    vector<uint32_t> idUsuario = codigos.usuarios.sort();
+    vector<uint32_t> idCancion = codigos.canciones.sort();
+    size_t partes = parallel_threads();
+    parallel_run(partes, [&](size_t parte)
+                 {
+        size_t fin = valoraciones.size() * (parte + 1) / partes;
+        for (size_t i = valoraciones.size() * parte / partes; i < fin; i++)
+        {
+            valoraciones[i].usuario = idUsuario[valoraciones[i].usuario];
+            valoraciones[i].cancion = idCancion[valoraciones[i].cancion];
+        } });
 
-    Valoracion *resultsSongs = new Valoracion[numSongs];
-    topNSongsWithoutCustomVal(numSongs, songs, resultsSongs, 3.0f, 5.0f);
+    // Las filas se guardan en el orden por valor: así los recorridos por valor leen el almacén en
+    // secuencia y las filas con la misma clave en otro índice quedan en ese mismo orden
+    parallel_stable_sort(valoraciones.begin(), valoraciones.end());
+}
 
-    // cout << "Top " << numSongs << " canciones con sus valores totales:" << endl;
+void topPUsersNearKUser(uint32_t kUser, int p, const FuenteAdyacencia &adyacencia, uint32_t *resultUsers)
+{
+    int numSongs = 2;
 
-    // for (int i = 0; i < numSongs; ++i)
-    // {
-    //     if (resultsSongs[i].codigoCancion != "")
-    //     {
-    //         if (resultsSongs[i].codigoCancion != "")
-    //         {
-    //             cout << "Canción: " << resultsSongs[i].codigoCancion << ", Valoración: " << resultsSongs[i].valor << endl;
-    //         }
-    //     }
-    // }
+    PuntajeCancion *resultsSongs = new PuntajeCancion[numSongs];
+    CopiaAdyacencia copia;
+    topNSongsWithoutCustomVal(numSongs, adyacencia.canciones(kUser, copia), resultsSongs, 3.0f, 5.0f);
 
-    unordered_map<string, pair<int, int>> valoracionesPorCancion;
+    unordered_map<uint32_t, pair<int, int>> valoracionesPorCancion;
 
     for (int i = 0; i < numSongs; i++)
     {
-        ValoracionPtrPorCancion startCancion(resultsSongs[i].codigoCancion, nullptr);
-        ValoracionPtrPorCancion endCancion(resultsSongs[i].codigoCancion, nullptr);
-        ValoracionPtrPorCancion *resultsCancion = new ValoracionPtrPorCancion[100000];
-        int countCancion = treePorCancion.range_search(startCancion, endCancion, resultsCancion, 100000);
-
-        for (int j = 0; j < countCancion; j++)
+        ListaAdyacencia usuarios = adyacencia.usuarios(resultsSongs[i].cancion, copia);
+        for (size_t j = 0; j < usuarios.size; j++)
         {
-            Valoracion *current = resultsCancion[j].ptr;
-            if (current != nullptr)
+            int valor = static_cast<int>(usuarios.medias[j] * 0.5f);
+            if (i == 1)
+            {
+                valoracionesPorCancion[usuarios.ids[j]].first = valor;
+            }
+            else
             {
-                if (i == 1)
-                {
-                    valoracionesPorCancion[current->codigoUsuario].first = static_cast<int>(current->valor);
-                }
-                else
-                {
-                    valoracionesPorCancion[current->codigoUsuario].second = static_cast<int>(current->valor);
-                }
+                valoracionesPorCancion[usuarios.ids[j]].second = valor;
             }
         }
     }
 
-    vector<pair<string, double>> nearestUsers;
+    vector<pair<uint32_t, double>> nearestUsers;
 
     for (const auto &par : valoracionesPorCancion)
     {
-        const string &usuario = par.first;
+        uint32_t usuario = par.first;
         int valor1OtherUser = par.second.first;
         int valor2OtherUser = par.second.second;
 
-        int valor1KUser = static_cast<int>(resultsSongs[0].valor);
-        int valor2KUser = static_cast<int>(resultsSongs[1].valor);
+        int valor1KUser = static_cast<int>(resultsSongs[0].puntaje);
+        int valor2KUser = static_cast<int>(resultsSongs[1].puntaje);
 
         int valor1Distancia = abs(valor1OtherUser - valor1KUser);
         int valor2Distancia = abs(valor2OtherUser - valor2KUser);
@@ -247,141 +582,205 @@ void topPUsersNearKUser(string kUser, int p, BPlusTree<ValoracionPtrPorUsuario>
             static_cast<double>(valor1Distancia * valor1Distancia +
                                 valor2Distancia * valor2Distancia));
 
-        // cout << "Usuario: " << usuario << endl;
-        // cout << "  Valor 1 " << kUser << ":" << valor1KUser << ", " << usuario << ": " << valor1OtherUser
-        //      << " -> Distancia: " << valor1Distancia << endl;
-        // cout << "  Valor 2 " << kUser << ":" << valor2KUser << ", " << usuario << ": " << valor2OtherUser
-        //      << " -> Distancia: " << valor2Distancia << endl;
-        // cout << "  Distancia Euclidiana: " << distanciaEuclidiana << endl;
-
         nearestUsers.emplace_back(usuario, distanciaEuclidiana);
     }
 
     sort(nearestUsers.begin(), nearestUsers.end(), [](const auto &a, const auto &b)
-         { return a.second < b.second; });
+         { return a.second < b.second || (a.second == b.second && a.first < b.first); });
 
     for (int i = 0; i < p && i < static_cast<int>(nearestUsers.size()); ++i)
     {
         resultUsers[i] = nearestUsers[i].first;
     }
+    delete[] resultsSongs;
 }
 
-void topNSongs(int n, BPlusTree<Valoracion> &tree, Valoracion *resultSongs, float minValue, float maxValue)
+// Puntaje de cada canción, en el orden en que aparece por primera vez. Cada hilo suma su parte
+// del recorrido en una de estas y las partes se unen en orden.
+struct PuntajesCanciones
 {
+    unordered_map<uint32_t, size_t> posicion;
+    vector<pair<uint32_t, float>> puntajes;
 
-    Valoracion start("", "", minValue);
-    Valoracion end("", "", maxValue);
-
-    Valoracion *results = new Valoracion[100000];
-
-    int count = tree.range_search(start, end, results, 100000);
+    void sumar(uint32_t cancion, float valor)
+    {
+        auto found = posicion.emplace(cancion, puntajes.size());
+        if (found.second)
+            puntajes.emplace_back(cancion, 0.0f);
+        puntajes[found.first->second].second += valor;
+    }
+    void unir(const PuntajesCanciones &otra)
+    {
+        for (const auto &p : otra.puntajes)
+            sumar(p.first, p.second);
+    }
+};
 
-    unordered_map<string, float> valoraciones;
+// Puntaje de una valoración en el Top N global: 30 las de 5 estrellas, 10 por estrella sobre
+// 2.5 y -10 por estrella bajo 2.5, y -30 el resto
+float puntajeGlobal(float valor)
+{
+    if (valor == 5.0f)
+    {
+        return 30.0f;
+    }
+    else if (valor > 2.5f && valor < 5.0f)
+    {
+        return 10.0f * (valor - 2.5f);
+    }
+    else if (valor > 0.0f && valor <= 2.5f)
+    {
+        return -10.0f * (2.5f - valor);
+    }
+    else
+    {
+        return -30.0f;
+    }
+}
 
-    for (int i = 0; i < count; i++)
+// Las n canciones de mayor puntaje, los empates por id. nth_element las separa y solo esas se
+// ordenan
+static void elegirTopN(int n, vector<pair<uint32_t, float>> &puntajes, PuntajeCancion *resultSongs)
+{
+    auto mejor = [](const pair<uint32_t, float> &a, const pair<uint32_t, float> &b)
     {
-        Valoracion current = results[i];
-        float value;
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
+    auto ultima = puntajes.begin() + min<size_t>(max(n, 0), puntajes.size());
+    nth_element(puntajes.begin(), ultima, puntajes.end(), mejor);
+    sort(puntajes.begin(), ultima, mejor);
+    for (auto p = puntajes.begin(); p != ultima; ++p)
+    {
+        resultSongs[p - puntajes.begin()] = {p->first, p->second};
+    }
+}
 
-        if (current.valor == 5.0f)
-        {
-            value = 30.0f;
-        }
-        else if (current.valor > 2.5f && current.valor < 5.0f)
-        {
-            value = 10.0f * (current.valor - 2.5f);
-        }
-        else if (current.valor > 0.0f && current.valor <= 2.5f)
+void topNSongs(int n, IndicePorValor &tree, IndicePorTiempo &porTiempo, const AgregadosCanciones &agregados, PuntajeCancion *resultSongs,
+               float minValue, float maxValue, const VentanaTiempo &ventana)
+{
+    // Sin ventana de tiempo el puntaje de cada canción sale de cuántas valoraciones tiene con
+    // cada valor, sin recorrer las valoraciones: la consulta cuesta lo mismo con cualquier
+    // cantidad. Por encima de 5 estrellas los valores no se distinguen, así que ahí se recorren
+    if (ventana.todas() && ventana.vidaMedia <= 0 && maxValue <= AgregadosCanciones::MAX_MEDIAS * 0.5f)
+    {
+        vector<pair<uint16_t, float>> enRango; // medias y su puntaje
+        for (uint16_t medias = 0; medias <= AgregadosCanciones::MAX_MEDIAS; medias++)
         {
-            value = -10.0f * (2.5f - current.valor);
+            if (minValue <= medias * 0.5f && medias * 0.5f <= maxValue)
+                enRango.emplace_back(medias, puntajeGlobal(medias * 0.5f));
         }
-        else
+        vector<pair<uint32_t, float>> puntajes;
+        for (uint32_t cancion = 0; cancion < agregados.canciones(); cancion++)
         {
-            value = -30.0f;
+            const AgregadosCanciones::Agregado &agregado = agregados[cancion];
+            uint32_t cuantas = 0;
+            double puntaje = 0;
+            for (const auto &m : enRango)
+            {
+                cuantas += agregado.cuentas[m.first];
+                puntaje += double(agregado.cuentas[m.first]) * m.second;
+            }
+            if (cuantas > 0)
+                puntajes.emplace_back(cancion, static_cast<float>(puntaje));
         }
-
-        valoraciones[current.codigoCancion] += value;
+        elegirTopN(n, puntajes, resultSongs);
+        return;
     }
-    vector<pair<string, float>> ordenadas(valoraciones.begin(), valoraciones.end());
-
-    sort(ordenadas.begin(), ordenadas.end(),
-         [](const pair<string, float> &a, const pair<string, float> &b)
-         {
-             return a.second > b.second;
-         });
 
-    int print_count = min(n, static_cast<int>(ordenadas.size()));
-    for (int i = 0; i < print_count; i++)
+    auto sumar = [&ventana](PuntajesCanciones &parte, const Valoracion &current)
+    { parte.sumar(current.cancion, puntajeGlobal(current.valor()) * ventana.peso(current.tiempo)); };
+    auto unir = [](PuntajesCanciones &acumulado, const PuntajesCanciones &parte)
+    { acumulado.unir(parte); };
+
+    // El rango se reparte entre todos los núcleos. Sin ventana de tiempo se recorre el rango de
+    // valores del índice por valor; con ventana, el rango de tiempo del índice por tiempo. En los
+    // dos el otro filtro corre sobre la columna de las hojas, y solo se leen las valoraciones que
+    // lo pasan
+    PuntajesCanciones total;
+    if (ventana.todas())
     {
-        resultSongs[i] = Valoracion("", ordenadas[i].first, ordenadas[i].second);
+        Valoracion start(0, 0, minValue); // antes que cualquier valoración con ese valor
+        Valoracion end(StringDictionary::NONE, StringDictionary::NONE, maxValue);
+        total = tree.parallel_range_reduce(start, end, IndicePorValor::ColumnRange{minValue, maxValue}, PuntajesCanciones(), sumar, unir);
     }
-    delete[] results;
+    else
+        total = porTiempo.parallel_range_reduce(ventana.desde, ventana.hasta, IndicePorTiempo::ColumnRange{minValue, maxValue}, PuntajesCanciones(), sumar, unir);
+    elegirTopN(n, total.puntajes, resultSongs);
 }
 
-void topNSongsWithoutCustomVal(int n, BPlusTree<Valoracion> &tree, Valoracion *resultSongs, float minValue, float maxValue)
+// Sobre un índice paginado se recorre el rango de valores de su árbol por valor. Los puntajes se
+// suman en double, como los agregados, así que sin ventana dan lo mismo que en memoria
+void topNSongs(int n, const IndicePaginado &indice, PuntajeCancion *resultSongs, float minValue, float maxValue, const VentanaTiempo &ventana)
 {
+    unordered_map<uint32_t, double> porCancion;
+    indice.recorrerValores(minValue, maxValue, [&](const Valoracion &v)
+                           {
+        if (ventana.contiene(v.tiempo))
+            porCancion[v.cancion] += puntajeGlobal(v.valor()) * ventana.peso(v.tiempo); });
+    vector<pair<uint32_t, float>> puntajes;
+    puntajes.reserve(porCancion.size());
+    for (const auto &p : porCancion)
+        puntajes.emplace_back(p.first, static_cast<float>(p.second));
+    elegirTopN(n, puntajes, resultSongs);
+}
 
-    Valoracion start("", "", minValue);
-    Valoracion end("", "", maxValue);
-
-    Valoracion *results = new Valoracion[100000];
-
-    int count = tree.range_search(start, end, results, 100000);
-
-    unordered_map<string, float> valoraciones;
+void topNSongsWithoutCustomVal(int n, const ListaAdyacencia &canciones, PuntajeCancion *resultSongs, float minValue, float maxValue,
+                               const VentanaTiempo &ventana)
+{
+    uint16_t desde = Valoracion::aMedias(minValue);
+    uint16_t hasta = Valoracion::aMedias(maxValue);
 
-    for (int i = 0; i < count; i++)
+    // Las canciones vienen en orden de id, así que las valoraciones repetidas de una canción
+    // quedan juntas y se suman sin un mapa
+    vector<pair<uint32_t, float>> ordenadas;
+    for (size_t i = 0; i < canciones.size; i++)
     {
-        Valoracion current = results[i];
-        valoraciones[current.codigoCancion] += current.valor;
+        if (canciones.medias[i] < desde || canciones.medias[i] > hasta || !ventana.contiene(canciones.tiempos[i]))
+            continue;
+        float valor = canciones.medias[i] * 0.5f * ventana.peso(canciones.tiempos[i]);
+        if (!ordenadas.empty() && ordenadas.back().first == canciones.ids[i])
+            ordenadas.back().second += valor;
+        else
+            ordenadas.emplace_back(canciones.ids[i], valor);
     }
-    vector<pair<string, float>> ordenadas(valoraciones.begin(), valoraciones.end());
-
-    sort(ordenadas.begin(), ordenadas.end(),
-         [](const pair<string, float> &a, const pair<string, float> &b)
-         {
-             return a.second > b.second;
-         });
 
     int print_count = min(n, static_cast<int>(ordenadas.size()));
+    partial_sort(ordenadas.begin(), ordenadas.begin() + max(print_count, 0), ordenadas.end(),
+                 [](const pair<uint32_t, float> &a, const pair<uint32_t, float> &b)
+                 {
+                     return a.second > b.second || (a.second == b.second && a.first < b.first);
+                 });
+
     for (int i = 0; i < print_count; i++)
     {
-        resultSongs[i] = Valoracion("", ordenadas[i].first, ordenadas[i].second);
+        resultSongs[i] = {ordenadas[i].first, ordenadas[i].second};
     }
-    delete[] results;
 }
 
-void recommendNSongsToKUser(int n, string kUser, BPlusTree<ValoracionPtrPorUsuario> &treePorUsuario, BPlusTree<ValoracionPtrPorCancion> &treePorCancion)
+// Los vecinos se eligen con todas las valoraciones; la ventana se aplica a las canciones que se
+// toman de ellos
+void recommendNSongsToKUser(int n, const string &kUser, const FuenteAdyacencia &adyacencia, const CodigosValoraciones &codigos,
+                            const VentanaTiempo &ventana)
 {
-    string *nearestUsers = new string[50];
-    topPUsersNearKUser(kUser, 50, treePorUsuario, treePorCancion, nearestUsers);
+    uint32_t *nearestUsers = new uint32_t[50];
+    fill(nearestUsers, nearestUsers + 50, StringDictionary::NONE);
+    topPUsersNearKUser(codigos.usuarios.find(kUser), 50, adyacencia, nearestUsers);
 
     int totalCount = 0;
-    Valoracion *resultSongs = new Valoracion[n];
+    PuntajeCancion *resultSongs = new PuntajeCancion[n];
 
     for (int i = 0; i < 50 && totalCount < n; i++)
     {
-        if (nearestUsers[i].empty())
+        if (nearestUsers[i] == StringDictionary::NONE)
             continue;
 
-        ValoracionPtrPorUsuario start(nearestUsers[i], nullptr);
-        ValoracionPtrPorUsuario end(nearestUsers[i], nullptr);
-        ValoracionPtrPorUsuario *results = new ValoracionPtrPorUsuario[100000];
-        int userCount = treePorUsuario.range_search(start, end, results, 100000);
-
-        BPlusTree<Valoracion> songsUsuario(100);
-        for (int j = 0; j < userCount; j++)
-        {
-            songsUsuario.insert(*results[j].ptr);
-        }
-        delete[] results;
-
-        Valoracion *resultTopSongs = new Valoracion[n];
-        topNSongsWithoutCustomVal(n, songsUsuario, resultTopSongs, 5.0f, 5.0f);
+        PuntajeCancion *resultTopSongs = new PuntajeCancion[n];
+        CopiaAdyacencia copia;
+        topNSongsWithoutCustomVal(n, adyacencia.canciones(nearestUsers[i], copia), resultTopSongs, 5.0f, 5.0f, ventana);
 
         for (int j = 0; j < n && totalCount < n; ++j)
         {
-            if (!resultTopSongs[j].codigoCancion.empty())
+            if (resultTopSongs[j].cancion != StringDictionary::NONE)
             {
                 resultSongs[totalCount++] = resultTopSongs[j];
             }
@@ -393,7 +792,7 @@ void recommendNSongsToKUser(int n, string kUser, BPlusTree<ValoracionPtrPorUsuar
     cout << n << " canciones recomendadas para el usuario " << kUser << ":" << endl;
     for (int i = 0; i < totalCount; i++)
     {
-        cout << "Canción: " << resultSongs[i].codigoCancion << ", Valor: " << resultSongs[i].valor << endl;
+        cout << "Canción: " << codigo(codigos.canciones, resultSongs[i].cancion) << ", Valor: " << resultSongs[i].puntaje << endl;
     }
 
     delete[] nearestUsers;
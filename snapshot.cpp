@@ -0,0 +1,235 @@
+#include "snapshot.h"
+#include "Parallel.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char SNAPSHOT_MAGIC[8] = {'B', 'P', 'T', 'S', 'N', 'A', 'P', '5'};
+static const uint32_t SNAPSHOT_VERSION = 5;
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+static void escribirConRelleno(ofstream &out, const void *data, size_t bytes)
+{
+    static const char ceros[8] = {};
+    out.write(static_cast<const char *>(data), bytes);
+    out.write(ceros, align8(bytes) - bytes);
+}
+
+Snapshot::Snapshot() : base(nullptr), longitud(0), cabecera(nullptr), tablaDeCodigos(nullptr), pool(nullptr),
+                       tabla(nullptr), ordenPorValor(nullptr), ordenPorUsuario(nullptr), ordenPorCancion(nullptr),
+                       ordenPorTiempo(nullptr) {}
+
+Snapshot::~Snapshot()
+{
+    cerrar();
+}
+
+bool Snapshot::guardar(const string &path, const AlmacenValoraciones &almacen, const CodigosValoraciones &codigos,
+                       IndicePorValor &porValor, IndicePorUsuario &porUsuario, IndicePorCancion &porCancion, IndicePorTiempo &porTiempo)
+{
+    vector<CodigoSnapshot> tablaCodigos;
+    string pool;
+    for (const StringDictionary *diccionario : {&codigos.usuarios, &codigos.canciones})
+    {
+        for (uint32_t id = 0; id < diccionario->size(); id++)
+        {
+            const string &codigo = (*diccionario)[id];
+            tablaCodigos.push_back({static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(codigo.size())});
+            pool += codigo;
+        }
+    }
+
+    // Las filas vivas en orden de fila; las quitadas no dejan hueco en el archivo
+    vector<Valoracion> valoraciones;
+    vector<uint32_t> renumerar(almacen.size(), 0);
+    valoraciones.reserve(almacen.live_size());
+    for (uint32_t fila = 0; fila < almacen.size(); fila++)
+    {
+        if (!almacen.live(fila))
+            continue;
+        renumerar[fila] = static_cast<uint32_t>(valoraciones.size());
+        valoraciones.push_back(almacen[fila]);
+    }
+
+    vector<uint32_t> ordenValor, ordenUsuario, ordenCancion, ordenTiempo;
+    ordenValor.reserve(valoraciones.size());
+    ordenUsuario.reserve(valoraciones.size());
+    ordenCancion.reserve(valoraciones.size());
+    ordenTiempo.reserve(valoraciones.size());
+    porValor.for_each_row([&](uint32_t fila)
+                          { ordenValor.push_back(renumerar[fila]); });
+    porUsuario.for_each_row([&](uint32_t fila)
+                            { ordenUsuario.push_back(renumerar[fila]); });
+    porCancion.for_each_row([&](uint32_t fila)
+                            { ordenCancion.push_back(renumerar[fila]); });
+    porTiempo.for_each_row([&](uint32_t fila)
+                           { ordenTiempo.push_back(renumerar[fila]); });
+    if (ordenValor.size() != valoraciones.size() || ordenUsuario.size() != valoraciones.size() ||
+        ordenCancion.size() != valoraciones.size() || ordenTiempo.size() != valoraciones.size())
+        return false;
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out.is_open())
+        return false;
+    CabeceraSnapshot cabecera = {};
+    memcpy(cabecera.magic, SNAPSHOT_MAGIC, sizeof(cabecera.magic));
+    cabecera.version = SNAPSHOT_VERSION;
+    cabecera.usuarios = codigos.usuarios.size();
+    cabecera.canciones = codigos.canciones.size();
+    cabecera.filas = valoraciones.size();
+    cabecera.poolBytes = pool.size();
+    escribirConRelleno(out, &cabecera, sizeof(cabecera));
+    escribirConRelleno(out, tablaCodigos.data(), tablaCodigos.size() * sizeof(CodigoSnapshot));
+    escribirConRelleno(out, pool.data(), pool.size());
+    escribirConRelleno(out, valoraciones.data(), valoraciones.size() * sizeof(Valoracion));
+    escribirConRelleno(out, ordenValor.data(), ordenValor.size() * sizeof(uint32_t));
+    escribirConRelleno(out, ordenUsuario.data(), ordenUsuario.size() * sizeof(uint32_t));
+    escribirConRelleno(out, ordenCancion.data(), ordenCancion.size() * sizeof(uint32_t));
+    escribirConRelleno(out, ordenTiempo.data(), ordenTiempo.size() * sizeof(uint32_t));
+    return static_cast<bool>(out);
+}
+
+bool Snapshot::abrir(const string &path)
+{
+    cerrar();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CabeceraSnapshot))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *mapeo = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapeo == MAP_FAILED)
+        return false;
+    base = static_cast<const char *>(mapeo);
+    longitud = st.st_size;
+
+    cabecera = reinterpret_cast<const CabeceraSnapshot *>(base);
+    if (memcmp(cabecera->magic, SNAPSHOT_MAGIC, sizeof(cabecera->magic)) != 0 || cabecera->version != SNAPSHOT_VERSION)
+    {
+        cerrar();
+        return false;
+    }
+    if (cabecera->usuarios > longitud || cabecera->canciones > longitud || cabecera->poolBytes > longitud || cabecera->filas > longitud)
+    {
+        cerrar();
+        return false;
+    }
+    size_t posicion = align8(sizeof(CabeceraSnapshot));
+    size_t codigosEn = posicion;
+    posicion += align8((uint64_t(cabecera->usuarios) + cabecera->canciones) * sizeof(CodigoSnapshot));
+    size_t poolEn = posicion;
+    posicion += align8(cabecera->poolBytes);
+    size_t valoracionesEn = posicion;
+    posicion += align8(cabecera->filas * sizeof(Valoracion));
+    size_t valorEn = posicion;
+    posicion += align8(cabecera->filas * sizeof(uint32_t));
+    size_t usuarioEn = posicion;
+    posicion += align8(cabecera->filas * sizeof(uint32_t));
+    size_t cancionEn = posicion;
+    posicion += align8(cabecera->filas * sizeof(uint32_t));
+    size_t tiempoEn = posicion;
+    posicion += align8(cabecera->filas * sizeof(uint32_t));
+    if (posicion > longitud)
+    {
+        cerrar();
+        return false;
+    }
+    tablaDeCodigos = reinterpret_cast<const CodigoSnapshot *>(base + codigosEn);
+    pool = base + poolEn;
+    tabla = reinterpret_cast<const Valoracion *>(base + valoracionesEn);
+    ordenPorValor = reinterpret_cast<const uint32_t *>(base + valorEn);
+    ordenPorUsuario = reinterpret_cast<const uint32_t *>(base + usuarioEn);
+    ordenPorCancion = reinterpret_cast<const uint32_t *>(base + cancionEn);
+    ordenPorTiempo = reinterpret_cast<const uint32_t *>(base + tiempoEn);
+    return true;
+}
+
+void Snapshot::cerrar()
+{
+    if (base != nullptr)
+        munmap(const_cast<char *>(base), longitud);
+    base = nullptr;
+    longitud = 0;
+    cabecera = nullptr;
+}
+
+// Si filas son las filas del almacén en el orden del índice de Clave: (clave, fila) estrictamente
+// creciente, así que tampoco hay filas repetidas, y con cuantas filas en rango es una permutación
+template <typename Clave>
+static bool enOrdenDeIndice(const AlmacenValoraciones &almacen, const uint32_t *filas, uint64_t cuantas)
+{
+    Clave clave;
+    for (uint64_t i = 0; i < cuantas; i++)
+    {
+        if (filas[i] >= cuantas)
+            return false;
+        if (i == 0)
+            continue;
+        const auto &anterior = clave(almacen[filas[i - 1]]);
+        const auto &actual = clave(almacen[filas[i]]);
+        if (actual < anterior || (!(anterior < actual) && filas[i] <= filas[i - 1]))
+            return false;
+    }
+    return true;
+}
+
+bool Snapshot::cargar(AlmacenValoraciones &almacen, CodigosValoraciones &codigos)
+{
+    if (cabecera == nullptr || almacen.size() != 0 || codigos.usuarios.size() != 0 || codigos.canciones.size() != 0)
+        return false;
+    uint64_t cuantas = cabecera->filas;
+    uint64_t cuantosCodigos = uint64_t(cabecera->usuarios) + cabecera->canciones;
+    for (uint64_t i = 0; i < cuantosCodigos; i++)
+    {
+        if (uint64_t(tablaDeCodigos[i].posicion) + tablaDeCodigos[i].longitud > cabecera->poolBytes)
+            return false;
+    }
+    bool enRango = true;
+    for (uint64_t i = 0; i < cuantas; i++)
+        enRango &= tabla[i].usuario < cabecera->usuarios && tabla[i].cancion < cabecera->canciones;
+    if (!enRango)
+        return false;
+
+    // Los códigos se internan en el orden del archivo, así que conservan sus ids
+    codigos.usuarios.reserve(cabecera->usuarios);
+    for (uint32_t id = 0; id < cabecera->usuarios; id++)
+    {
+        if (codigos.usuarios.intern(codigo(id)) != id)
+            return false; // código repetido
+    }
+    codigos.canciones.reserve(cabecera->canciones);
+    for (uint32_t id = 0; id < cabecera->canciones; id++)
+    {
+        if (codigos.canciones.intern(codigo(cabecera->usuarios + id)) != id)
+            return false;
+    }
+
+    // Las valoraciones del archivo ya son registros Valoracion: pasan al almacén en una copia
+    almacen.append_batch(vector<Valoracion>(tabla, tabla + cuantas));
+
+    // Un orden que no es el de su índice no se usa: ese índice se construye ordenando
+    parallel_run(4, [&](size_t indice)
+                 {
+        if (indice == 0 && !enOrdenDeIndice<ClavePorValor>(almacen, ordenPorValor, cuantas))
+            ordenPorValor = nullptr;
+        else if (indice == 1 && !enOrdenDeIndice<ClavePorUsuario>(almacen, ordenPorUsuario, cuantas))
+            ordenPorUsuario = nullptr;
+        else if (indice == 2 && !enOrdenDeIndice<ClavePorCancion>(almacen, ordenPorCancion, cuantas))
+            ordenPorCancion = nullptr;
+        else if (indice == 3 && !enOrdenDeIndice<ClavePorTiempo>(almacen, ordenPorTiempo, cuantas))
+            ordenPorTiempo = nullptr; });
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "valoracion.h"
+#include "valoracionIndices.h"
+
+using namespace std;
+
+// Snapshot binario del almacén, sus códigos y sus cuatro índices, que se lee con mmap. La tabla
+// de códigos tiene los de usuario y luego los de canción, en orden de id, así que las
+// valoraciones conservan sus ids. Las valoraciones son las filas vivas del almacén, numeradas
+// desde 0 y guardadas byte a byte (Valoracion es un registro trivialmente copiable), y cada
+// índice son esas filas en el orden del índice.
+//
+//   CabeceraSnapshot | CodigoSnapshot[usuarios + canciones] | pool | Valoracion[filas]
+//   | uint32 porValor[filas] | uint32 porUsuario[filas] | uint32 porCancion[filas]
+//   | uint32 porTiempo[filas], secciones alineadas a 8 bytes.
+struct CabeceraSnapshot
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t usuarios; // códigos en la tabla
+    uint32_t canciones;
+    uint32_t reservado;
+    uint64_t filas;
+    uint64_t poolBytes;
+};
+
+struct CodigoSnapshot
+{
+    uint32_t posicion; // en el pool
+    uint32_t longitud;
+};
+
+class Snapshot
+{
+    const char *base;
+    size_t longitud;
+    const CabeceraSnapshot *cabecera;
+    const CodigoSnapshot *tablaDeCodigos;
+    const char *pool;
+    const Valoracion *tabla;
+    const uint32_t *ordenPorValor;
+    const uint32_t *ordenPorUsuario;
+    const uint32_t *ordenPorCancion;
+    const uint32_t *ordenPorTiempo;
+
+public:
+    Snapshot();
+    ~Snapshot();
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    // Escribe en path el almacén, sus códigos y sus índices
+    static bool guardar(const string &path, const AlmacenValoraciones &almacen, const CodigosValoraciones &codigos,
+                        IndicePorValor &porValor, IndicePorUsuario &porUsuario, IndicePorCancion &porCancion, IndicePorTiempo &porTiempo);
+
+    // Mapea el archivo. False si no se puede leer o no es un snapshot válido
+    bool abrir(const string &path);
+    void cerrar();
+
+    uint64_t filas() const { return cabecera->filas; }
+    const Valoracion *valoraciones() const { return tabla; }
+    const uint32_t *porValor() const { return ordenPorValor; }
+    const uint32_t *porUsuario() const { return ordenPorUsuario; }
+    const uint32_t *porCancion() const { return ordenPorCancion; }
+    const uint32_t *porTiempo() const { return ordenPorTiempo; }
+    string_view codigo(uint32_t indice) const { return string_view(pool + tablaDeCodigos[indice].posicion, tablaDeCodigos[indice].longitud); }
+
+    // Llena codigos y el almacén, que deben estar vacíos; las valoraciones conservan sus ids y
+    // sus filas, y pasan al almacén en una sola copia. Los índices se construyen después con
+    // porValor(), porUsuario(), porCancion() y porTiempo(), que ya están en orden, mientras el
+    // snapshot sigue abierto. Se comprueba que cada uno sea una permutación de las filas en el
+    // orden de su clave; el que no lo es pasa a nullptr y ese índice se construye ordenando.
+    // False si un id está fuera de rango.
+    bool cargar(AlmacenValoraciones &almacen, CodigosValoraciones &codigos);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,218 @@
+// PagedBPlusTree and BufferPool (user-007): build an index file, close it, open it again and
+// range-scan it, with a pool far smaller than the file so pages are evicted and read back.
+// Exits with 1 and says why on the first wrong result.
+//
+//   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -I. tests/paged_reopen.cpp -o paged_reopen && ./paged_reopen
+//
+// Keys are inserted in random order, then every third one is removed, then all but one in a thousand
+// (they fit in one leaf: the tree must lose its levels), then the removed ones come back (the file must not grow: freed
+// pages are reused); the file is reopened after each step. A second file is bulk-loaded and
+// reopened the same way. Small pages with many duplicates are checked against a std::multiset
+// under random inserts and removes. Last, close() must report pages that can't be written
+// (/dev/full), and the destructor must not throw.
+#include "PagedBPlusTree.h"
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const int KEYS = 200000;
+static const std::size_t BUDGET = 64 * 4096; // 64 pages, about 1/6 of the file
+
+static bool failed = false;
+
+static void check(bool ok, const char* what, long a = 0, long b = 0) {
+    if(!ok && !failed){
+        std::printf("FAIL: %s (%ld, %ld)\n", what, a, b);
+        failed = true;
+    }
+}
+
+// The tree at path must hold exactly the keys k in [0, KEYS) with present(k).
+template<typename Present>
+static void verify(const std::string& path, Present present) {
+    PagedBPlusTree<int> tree(path, BUDGET);
+    check(tree.is_open(), "reopen");
+    if(!tree.is_open()){
+        return;
+    }
+    long expected = 0;
+    for(int k=0; k<KEYS; k++){
+        expected += present(k);
+    }
+    check(tree.size() == static_cast<std::uint64_t>(expected), "size", tree.size(), expected);
+
+    int next = 0;
+    long seen = 0;
+    tree.for_each([&](int item){
+        while(next < KEYS && !present(next)){
+            next++;
+        }
+        check(item == next, "for_each", item, next);
+        next++;
+        seen++;
+    });
+    check(seen == expected, "for_each count", seen, expected);
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> pick(0, KEYS - 1);
+    for(int q=0; q<200; q++){
+        int start = pick(rng);
+        int end = std::min(KEYS - 1, start + 1000);
+        long in_range = 0;
+        for(int k=start; k<=end; k++){
+            in_range += present(k);
+        }
+        int previous = start - 1;
+        long scanned = 0;
+        tree.range_for_each(start, end, [&](int item){
+            check(item > previous && item <= end && present(item), "range_for_each", previous, item);
+            previous = item;
+            scanned++;
+        });
+        check(scanned == in_range, "range_for_each count", scanned, in_range);
+        int key = pick(rng);
+        check(tree.search(key) == present(key), "search", key, present(key));
+    }
+    check(tree.close(), "close after reading");
+}
+
+static long file_size(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<long>(st.st_size) : -1;
+}
+
+// 128-byte pages hold 28 ints per leaf and 13 keys per internal node, so the tree is deep and
+// pages merge and borrow often. Keys repeat many times, so equal runs span several leaves.
+static void duplicates(const std::string& path) {
+    unlink(path.c_str());
+    std::multiset<int> expected;
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> key(0, 300);
+    for(int round=0; round<4 && !failed; round++){
+        PagedBPlusTree<int> tree(path, 16 * 128, 128);
+        check(tree.is_open() && tree.size() == expected.size(), "duplicates reopen", round, tree.size());
+        int steps = round == 3 ? 60000 : 30000;
+        for(int step=0; step<steps; step++){
+            int k = key(rng);
+            bool add = round < 2 ? rng() % 3 != 0 : rng() % 3 == 0; // grow, then shrink
+            if(round == 3){
+                add = false;
+            }
+            if(add){
+                tree.insert(k);
+                expected.insert(k);
+            }
+            else{
+                auto found = expected.find(k);
+                check(tree.remove(k) == (found != expected.end()), "duplicates remove", k);
+                if(found != expected.end()){
+                    expected.erase(found);
+                }
+            }
+        }
+        std::vector<int> items;
+        tree.for_each([&](int item){ items.push_back(item); });
+        check(items == std::vector<int>(expected.begin(), expected.end()), "duplicates contents", items.size(), expected.size());
+        int k = key(rng);
+        long equal = 0;
+        tree.range_for_each(k, k, [&](int){ equal++; });
+        check(equal == static_cast<long>(expected.count(k)), "duplicates range", equal, expected.count(k));
+        check(tree.close(), "duplicates close");
+    }
+    check(expected.empty(), "duplicates emptied", expected.size());
+    {
+        PagedBPlusTree<int> tree(path, 16 * 128, 128);
+        check(tree.size() == 0 && tree.height() == 0, "empty tree", tree.size(), tree.height());
+        tree.insert(1);
+        check(tree.search(1), "insert after emptying");
+    }
+    unlink(path.c_str());
+}
+
+int main() {
+    std::string path = "paged_reopen_test.idx";
+    unlink(path.c_str());
+    std::vector<int> keys(KEYS);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    {
+        PagedBPlusTree<int> tree(path, BUDGET);
+        check(tree.is_open(), "create");
+        for(int k : keys){
+            tree.insert(k);
+        }
+        check(tree.close(), "close after insert");
+    }
+    verify(path, [](int){ return true; });
+
+    {
+        PagedBPlusTree<int> tree(path, BUDGET);
+        for(int k : keys){
+            if(k % 3 == 0){
+                check(tree.remove(k), "remove", k);
+            }
+        }
+        check(!tree.remove(0), "remove twice");
+        check(!tree.remove(KEYS), "remove missing");
+    } // closed by the destructor
+    verify(path, [](int k){ return k % 3 != 0; });
+
+    long full_size = file_size(path);
+    std::uint32_t full_height = 0;
+    {
+        PagedBPlusTree<int> tree(path, BUDGET);
+        full_height = tree.height();
+        for(int k : keys){
+            if(k % 3 != 0 && k % 1000 != 0){
+                check(tree.remove(k), "mass remove", k);
+            }
+        }
+        check(tree.height() == 1 && full_height > 1, "mass remove shrinks the tree", tree.height(), full_height);
+    }
+    verify(path, [](int k){ return k % 3 != 0 && k % 1000 == 0; });
+    {
+        PagedBPlusTree<int> tree(path, BUDGET);
+        for(int k : keys){
+            if(k % 3 == 0 || k % 1000 != 0){
+                tree.insert(k);
+            }
+        }
+    }
+    verify(path, [](int){ return true; });
+    check(file_size(path) <= full_size, "reinserting reuses freed pages", file_size(path), full_size);
+
+    {
+        PagedBPlusTree<int> tree(path, BUDGET);
+        std::vector<int> sorted(KEYS);
+        std::iota(sorted.begin(), sorted.end(), 0);
+        tree.bulk_load(sorted.begin(), sorted.end(), 0.7);
+        check(tree.close(), "close after bulk_load");
+    }
+    verify(path, [](int){ return true; });
+
+    {
+        PagedBPlusTree<long> other(path, BUDGET); // another record size
+        check(!other.is_open(), "record size check");
+    }
+    unlink(path.c_str());
+
+    duplicates(path);
+
+    if(access("/dev/full", W_OK) == 0){
+        PagedBPlusTree<int> full("/dev/full", BUDGET);
+        for(int k=0; k<1000; k++){
+            full.insert(k);
+        }
+        check(!full.close(), "close reports a failed write");
+        PagedBPlusTree<int> dropped("/dev/full", BUDGET);
+        dropped.insert(1);
+    } // dropped's failed write is swallowed by the destructor
+    std::printf("%s\n", failed ? "FAIL" : "ok");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+// BPlusTree<std::string> with the shortest-separator hook of BPlusTreeKey<std::string>
+// (user-009): the tree must hold the same strings as a std::multiset through inserts and
+// removes, and its internal nodes must keep short prefixes instead of whole keys.
+// Exits with 1 and says why on the first wrong result.
+//
+//   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -I. tests/string_keys.cpp -o string_keys && ./string_keys
+//
+// Keys are a random 6-letter head and a 30-character tail shared by all of them, so every key
+// owns heap memory but a few letters of the head separate any two leaves: the separators must
+// fit in the small-string buffer and own none, except where duplicates straddle a split and the
+// whole key is the only separator.
+#include "BPlusTree.h"
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+static const int KEYS = 50000;
+
+static bool failed = false;
+
+static void check(bool ok, const char* what, long a = 0, long b = 0) {
+    if(!ok && !failed){
+        std::printf("FAIL: %s (%ld, %ld)\n", what, a, b);
+        failed = true;
+    }
+}
+
+static void compare(BPlusTree<std::string>& tree, const std::multiset<std::string>& expected, const char* step) {
+    std::vector<std::string> items;
+    tree.for_each([&](std::string& item){ items.push_back(item); });
+    check(items == std::vector<std::string>(expected.begin(), expected.end()), step, items.size(), expected.size());
+}
+
+int main() {
+    const std::string tail(30, 'x');
+    std::mt19937 rng(9);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> keys;
+    for(int i=0; i<KEYS; i++){
+        std::string key;
+        for(int c=0; c<6; c++){
+            key += static_cast<char>(letter(rng));
+        }
+        keys.push_back(key + tail);
+    }
+    keys.push_back(keys[0]); // a few duplicates
+    keys.push_back(keys[1]);
+
+    BPlusTree<std::string> tree(16);
+    std::multiset<std::string> expected;
+    for(const std::string& key : keys){
+        tree.insert(key);
+        expected.insert(key);
+    }
+    compare(tree, expected, "contents after insert");
+
+    BPlusTreeStats stats = tree.stats();
+    check(stats.height > 2, "height", stats.height);
+    check(stats.leaf_key_bytes > 0, "leaf keys own heap", stats.leaf_key_bytes);
+    check(stats.separator_bytes < stats.leaf_key_bytes / 1000, "separators are short prefixes", stats.separator_bytes, stats.leaf_key_bytes);
+
+    for(int i=0; i<KEYS; i+=3){
+        check(tree.search(keys[i]), "search", i);
+    }
+    check(!tree.search("zzzzzz"), "search missing");
+    std::string start = keys[5].substr(0, 2);
+    std::string end = start + "~";
+    long in_range = std::distance(expected.lower_bound(start), expected.upper_bound(end));
+    std::vector<std::string> found(in_range + 1);
+    check(tree.range_search(start, end, found.data(), in_range + 1) == in_range, "range_search", in_range);
+
+    for(int i=0; i<KEYS; i+=2){
+        tree.remove(keys[i]);
+        expected.erase(expected.find(keys[i]));
+    }
+    compare(tree, expected, "contents after remove");
+    for(int i=1; i<KEYS; i+=2){
+        check(tree.search(keys[i]), "search after remove", i);
+    }
+
+    std::printf("%s\n", failed ? "FAIL" : "ok");
+    return failed ? 1 : 0;
+}
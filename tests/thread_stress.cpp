@@ -0,0 +1,134 @@
+// Stress test of the thread-safe mode of BPlusTree (user-006): readers search and range-scan
+// while one thread inserts and another removes, at a small and a regular degree. One more
+// reader runs parallel_range_reduce (user-014), which shares the tree latch with the inserts.
+// The remover tombstones every other key and runs compact_step (user-015) as it goes. Exits with 1
+// and says why if a reader sees a missing key or an unordered scan, or if the final contents
+// are wrong. Meant to run under ThreadSanitizer:
+//
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -I. tests/thread_stress.cpp -o thread_stress -pthread && ./thread_stress
+//
+// Even keys in [0, 2N) are loaded first and never touched, so readers can check for them. The
+// inserter adds the odd keys in [0, 2N); the remover deletes the keys in [2N, 3N), which are
+// also loaded first. At the end the tree must hold exactly [0, 2N).
+#include "BPlusTree.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+static std::atomic<bool> failed(false);
+
+static void fail(const char* what, int a, int b) {
+    if(!failed.exchange(true)){
+        std::printf("FAIL: %s (%d, %d)\n", what, a, b);
+    }
+}
+
+static void run(std::size_t degree, int n, int readers) {
+    BPlusTree<int> tree(degree, true);
+    std::vector<int> initial;
+    for(int key=0; key<2*n; key+=2){
+        initial.push_back(key);
+    }
+    for(int key=2*n; key<3*n; key++){
+        initial.push_back(key);
+    }
+    tree.bulk_load(initial.begin(), initial.end(), 0.7);
+
+    std::atomic<int> writers_left(2);
+    std::vector<std::thread> threads;
+    threads.emplace_back([&]{
+        for(int key=1; key<2*n; key+=2){
+            tree.insert(key);
+        }
+        writers_left--;
+    });
+    threads.emplace_back([&]{
+        for(int key=3*n-1; key>=2*n; key--){
+            if(key % 2 == 0){
+                tree.tombstone(key);
+            }
+            else{
+                tree.remove(key);
+            }
+            if(key % 64 == 0){
+                tree.compact_step(8);
+            }
+        }
+        writers_left--;
+    });
+    for(int r=0; r<readers; r++){
+        threads.emplace_back([&, r]{
+            std::mt19937 rng(r);
+            std::uniform_int_distribution<int> pick(0, n - 1);
+            while(writers_left > 0 && !failed){
+                int key = 2 * pick(rng);
+                if(!tree.search(key)){
+                    fail("stable key not found", key, 0);
+                }
+                int start = 2 * pick(rng);
+                int end = start + 200;
+                int previous = -1;
+                int evens = 0;
+                tree.range_for_each(start, end, [&](const int& item){
+                    if(item <= previous || item < start || item > end){
+                        fail("range scan out of order or out of range", previous, item);
+                    }
+                    previous = item;
+                    evens += item % 2 == 0 && item < 2 * n;
+                });
+                int expected = (std::min(end, 2 * n - 2) - start) / 2 + 1;
+                if(evens != expected){
+                    fail("range scan missed stable keys", start, evens);
+                }
+            }
+        });
+    }
+    threads.emplace_back([&]{
+        std::mt19937 rng(readers);
+        std::uniform_int_distribution<int> pick(0, n - 1);
+        while(writers_left > 0 && !failed){
+            int start = 2 * pick(rng);
+            int end = start + 2000;
+            std::vector<int> items = tree.parallel_range_reduce(start, end, std::vector<int>(),
+                [](std::vector<int>& acc, const int& item){ acc.push_back(item); },
+                [](std::vector<int>& acc, const std::vector<int>& part){ acc.insert(acc.end(), part.begin(), part.end()); }, 3);
+            int previous = start - 1;
+            int evens = 0;
+            for(int item : items){
+                if(item <= previous || item > end){
+                    fail("parallel range reduce out of order or out of range", previous, item);
+                }
+                previous = item;
+                evens += item % 2 == 0 && item < 2 * n;
+            }
+            int expected = (std::min(end, 2 * n - 2) - start) / 2 + 1;
+            if(evens != expected){
+                fail("parallel range reduce missed stable keys", start, evens);
+            }
+        }
+    });
+    for(std::thread& t : threads){
+        t.join();
+    }
+
+    int next = 0;
+    tree.for_each([&](const int& item){
+        if(item != next){
+            fail("final contents", next, item);
+        }
+        next++;
+    });
+    if(next != 2 * n){
+        fail("final size", next, 2 * n);
+    }
+    std::printf("degree %zu, %d keys, %d readers: %s\n", degree, 3 * n, readers, failed ? "FAIL" : "ok");
+}
+
+int main() {
+    run(5, 20000, 4);
+    run(50, 100000, 4);
+    return failed ? 1 : 0;
+}
@@ -1,45 +1,57 @@
 #include "valoracion.h"
+#include <cmath>
 
-Valoracion::Valoracion() : codigoUsuario(""), codigoCancion(""), valor(0) {}
+Valoracion::Valoracion() : usuario(StringDictionary::NONE), cancion(StringDictionary::NONE), tiempo(0), medias(0) {}
 
-Valoracion::Valoracion(const std::string &usuario, const std::string &cancion, float v)
-    : codigoUsuario(usuario), codigoCancion(cancion), valor(v) {}
+Valoracion::Valoracion(uint32_t u, uint32_t c, float v, uint32_t t)
+    : usuario(u), cancion(c), tiempo(t), medias(aMedias(v)) {}
+
+// Al media estrella más cercana. Como límite de un rango da el mismo resultado que v, porque
+// entre v y el redondeo no cae ninguna media estrella
+uint16_t Valoracion::aMedias(float v)
+{
+    if (!(v > 0.0f))
+        return 0;
+    if (v >= 32767.5f)
+        return UINT16_MAX;
+    return static_cast<uint16_t>(lround(v * 2.0f));
+}
 
 bool Valoracion::operator<(const Valoracion &other) const
 {
-    if (valor != other.valor)
-        return valor < other.valor;
-    if (codigoUsuario != other.codigoUsuario)
-        return codigoUsuario < other.codigoUsuario;
-    return codigoCancion < other.codigoCancion;
+    if (medias != other.medias)
+        return medias < other.medias;
+    if (usuario != other.usuario)
+        return usuario < other.usuario;
+    return cancion < other.cancion;
 }
 
 bool Valoracion::operator>(const Valoracion &other) const
 {
-    if (valor != other.valor)
-        return valor > other.valor;
-    if (codigoUsuario != other.codigoUsuario)
-        return codigoUsuario > other.codigoUsuario;
-    return codigoCancion > other.codigoCancion;
+    if (medias != other.medias)
+        return medias > other.medias;
+    if (usuario != other.usuario)
+        return usuario > other.usuario;
+    return cancion > other.cancion;
 }
 
 bool Valoracion::operator<=(const Valoracion &other) const
 {
-    return *this < other || valor == other.valor;
+    return *this < other || medias == other.medias;
 }
 bool Valoracion::operator>=(const Valoracion &other) const
 {
-    return *this > other || valor == other.valor;
+    return *this > other || medias == other.medias;
 }
 
 bool Valoracion::operator==(const Valoracion &other) const
 {
-    return codigoUsuario == other.codigoUsuario &&
-           codigoCancion == other.codigoCancion;
+    return usuario == other.usuario &&
+           cancion == other.cancion;
 }
 
 std::ostream &operator<<(std::ostream &os, const Valoracion &v)
 {
-    os << v.codigoUsuario << "," << v.codigoCancion << "," << v.valor;
+    os << v.usuario << "," << v.cancion << "," << v.valor() << "," << v.tiempo;
     return os;
-}
\ No newline at end of file
+}
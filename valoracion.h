@@ -1,18 +1,39 @@
 #ifndef VALORACION_H
 #define VALORACION_H
+#include <cstdint>
 #include <string>
 #include <iostream>
+#include <type_traits>
+#include "BPlusTreeKey.h"
+#include "PageRecord.h"
+#include "StringDictionary.h"
 
 using namespace std;
 
+// Códigos de usuarios y canciones. Las valoraciones guardan sus ids; tras la carga los ids
+// siguen el orden de los códigos (StringDictionary::sort), así que ordenar por id es ordenar
+// por código. Los códigos solo se consultan para leer la entrada y mostrar resultados.
+struct CodigosValoraciones
+{
+    StringDictionary usuarios;
+    StringDictionary canciones;
+};
+
+// Registro de 16 bytes, trivialmente copiable: los nodos y el almacén lo mueven con memmove.
+// El valor se guarda en medias estrellas (4.5 -> 9), así que las comparaciones son exactas. El
+// tiempo no entra en el orden: un usuario valora una canción una sola vez.
 class Valoracion {
 public:
-    string codigoUsuario;
-    string codigoCancion;
-    float valor;
+    uint32_t usuario; // ids en CodigosValoraciones; StringDictionary::NONE si no hay
+    uint32_t cancion;
+    uint32_t tiempo; // segundos desde 1970 (la cuarta columna del CSV); 0 si no se conoce
+    uint16_t medias;
 
     Valoracion();
-    Valoracion(const string& usuario, const string& cancion, float v);
+    Valoracion(uint32_t usuario, uint32_t cancion, float v, uint32_t tiempo = 0); // v se redondea a media estrella
+
+    float valor() const { return medias * 0.5f; }
+    static uint16_t aMedias(float v);
 
     bool operator<(const Valoracion& other) const;
     bool operator<=(const Valoracion& other) const;
@@ -20,7 +41,19 @@ public:
     bool operator>(const Valoracion& other) const;
     bool operator==(const Valoracion& other) const;
 
-    friend ostream& operator<<(ostream& os, const Valoracion& v);
+    friend ostream& operator<<(ostream& os, const Valoracion& v); // ids, no códigos
+};
+
+static_assert(sizeof(Valoracion) == 16 && is_trivially_copyable<Valoracion>::value, "Valoracion debe seguir siendo un registro compacto");
+
+// Leaves of a BPlusTree<Valoracion> keep the values in a column of their own, for scans
+// filtered by value; half stars are exact in a float, so the filter is too. Valoracion is
+// trivially copyable, so PageRecord stores its bytes.
+template <>
+struct BPlusTreeKey<Valoracion> {
+    static constexpr bool normalized = false;
+
+    static float column(const Valoracion& v) { return v.valor(); }
 };
 
-#endif // VALORACION_H;
\ No newline at end of file
+#endif // VALORACION_H
@@ -0,0 +1,247 @@
+#include "valoracionAdyacencia.h"
+#include <algorithm>
+#include <stdexcept>
+
+ListaAdyacencia ListasCSR::operator[](uint32_t fila) const
+{
+    if (fila >= filas())
+        return {nullptr, nullptr, nullptr, 0};
+    return {ids.data() + inicio[fila], medias.data() + inicio[fila], tiempos.data() + inicio[fila], inicio[fila + 1] - inicio[fila]};
+}
+
+// Marca un elemento vivo de la fila con ese id, valor y tiempo; los ids de la fila están en orden
+bool ListasCSR::quitar(uint32_t fila, uint32_t id, uint16_t valor, uint32_t tiempo)
+{
+    if (fila >= filas())
+        return false;
+    uint32_t fin = inicio[fila + 1];
+    for (uint32_t pos = lower_bound(ids.begin() + inicio[fila], ids.begin() + fin, id) - ids.begin(); pos < fin && ids[pos] == id; pos++)
+    {
+        if (!muerta[pos] && medias[pos] == valor && tiempos[pos] == tiempo)
+        {
+            muerta[pos] = true;
+            muertas[fila]++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Ordenamiento por conteo: una pasada cuenta los elementos de cada fila y otra los coloca. Los
+// elementos de una fila quedan en el orden en que los da el recorrido.
+template <typename Recorrido>
+void AdyacenciaValoraciones::repartir(ListasCSR &lista, uint32_t filas, size_t total, Recorrido recorrer)
+{
+    lista.inicio.assign(size_t(filas) + 1, 0);
+    recorrer([&](uint32_t fila, uint32_t, uint16_t, uint32_t)
+             { lista.inicio[fila + 1]++; });
+    for (uint32_t i = 0; i < filas; i++)
+        lista.inicio[i + 1] += lista.inicio[i];
+
+    lista.ids.resize(total);
+    lista.medias.resize(total);
+    lista.tiempos.resize(total);
+    vector<uint32_t> siguiente(lista.inicio.begin(), lista.inicio.end() - 1);
+    recorrer([&](uint32_t fila, uint32_t id, uint16_t medias, uint32_t tiempo)
+             {
+        uint32_t pos = siguiente[fila]++;
+        lista.ids[pos] = id;
+        lista.medias[pos] = medias;
+        lista.tiempos[pos] = tiempo; });
+    lista.muerta.assign(total, false);
+    lista.muertas.assign(filas, 0);
+}
+
+AdyacenciaValoraciones::AdyacenciaValoraciones(AlmacenValoraciones &_almacen, uint32_t usuarios, uint32_t canciones)
+    : almacen(&_almacen), filasBase(_almacen.size()), filasVistas(_almacen.size()), nuevas(0), quitadas(0)
+{
+    const AlmacenValoraciones &almacen = _almacen;
+    size_t total = almacen.live_size();
+    for (uint32_t fila = 0; fila < almacen.size(); fila++)
+    {
+        if (almacen.live(fila) && (almacen[fila].usuario >= usuarios || almacen[fila].cancion >= canciones))
+            throw out_of_range("AdyacenciaValoraciones: id out of range");
+    }
+
+    // Tres pasadas lineales: por canción en orden de fila, de ahí por usuario (las canciones de
+    // cada usuario salen en orden creciente) y de nuevo por canción (los usuarios también)
+    repartir(porCancion, canciones, total, [&](auto colocar)
+             {
+        for (uint32_t fila = 0; fila < almacen.size(); fila++)
+        {
+            if (almacen.live(fila))
+                colocar(almacen[fila].cancion, almacen[fila].usuario, almacen[fila].medias, almacen[fila].tiempo);
+        } });
+    auto transponer = [](const ListasCSR &origen)
+    {
+        return [&origen](auto colocar)
+        {
+            for (uint32_t fila = 0; fila < origen.filas(); fila++)
+            {
+                for (uint32_t pos = origen.inicio[fila]; pos < origen.inicio[fila + 1]; pos++)
+                    colocar(origen.ids[pos], fila, origen.medias[pos], origen.tiempos[pos]);
+            }
+        };
+    };
+    repartir(porUsuario, usuarios, total, transponer(porCancion));
+    repartir(porCancion, canciones, total, transponer(porUsuario));
+    _almacen.listen(this);
+}
+
+AdyacenciaValoraciones::~AdyacenciaValoraciones()
+{
+    almacen->unlisten(this);
+}
+
+void AdyacenciaValoraciones::agregar(uint32_t fila)
+{
+    const Valoracion &v = (*almacen)[fila];
+    nuevasPorUsuario[v.usuario].push_back(fila);
+    nuevasPorCancion[v.cancion].push_back(fila);
+    nuevas++;
+    filasVistas = fila + 1;
+}
+
+void AdyacenciaValoraciones::row_added(uint32_t fila)
+{
+    agregar(fila);
+    consolidarSiHaceFalta();
+}
+
+void AdyacenciaValoraciones::rows_added(uint32_t primera, uint32_t ultima)
+{
+    for (uint32_t fila = primera; fila < ultima; fila++)
+        agregar(fila);
+    consolidarSiHaceFalta();
+}
+
+void AdyacenciaValoraciones::row_removed(uint32_t fila)
+{
+    const Valoracion &v = (*almacen)[fila];
+    if (fila < filasBase)
+    {
+        if (porUsuario.quitar(v.usuario, v.cancion, v.medias, v.tiempo))
+            quitadas++;
+        porCancion.quitar(v.cancion, v.usuario, v.medias, v.tiempo);
+    }
+    else
+    {
+        // Las filas nuevas se agregan en orden
+        bool estaba = false;
+        for (vector<uint32_t> *filas : {&nuevasPorUsuario[v.usuario], &nuevasPorCancion[v.cancion]})
+        {
+            auto pos = lower_bound(filas->begin(), filas->end(), fila);
+            if (pos != filas->end() && *pos == fila)
+            {
+                filas->erase(pos);
+                estaba = true;
+            }
+        }
+        if (estaba)
+            nuevas--;
+    }
+    consolidarSiHaceFalta();
+}
+
+// Una lista nueva con la vista de cada fila: las vivas de la lista y las nuevas, en el orden en
+// que las da vista(). Abarca también los ids que solo tienen filas nuevas
+void AdyacenciaValoraciones::consolidar(ListasCSR &lista, const unordered_map<uint32_t, vector<uint32_t>> &nuevas, bool deUsuario)
+{
+    uint32_t filas = lista.filas();
+    for (const auto &par : nuevas)
+    {
+        if (!par.second.empty())
+            filas = max(filas, par.first + 1);
+    }
+    ListasCSR armada;
+    armada.inicio.assign(size_t(filas) + 1, 0);
+    size_t total = lista.ids.size() - quitadas + this->nuevas;
+    armada.ids.reserve(total);
+    armada.medias.reserve(total);
+    armada.tiempos.reserve(total);
+    CopiaAdyacencia copia;
+    for (uint32_t fila = 0; fila < filas; fila++)
+    {
+        ListaAdyacencia l = vista(lista, nuevas, deUsuario, fila, copia);
+        armada.ids.insert(armada.ids.end(), l.ids, l.ids + l.size);
+        armada.medias.insert(armada.medias.end(), l.medias, l.medias + l.size);
+        armada.tiempos.insert(armada.tiempos.end(), l.tiempos, l.tiempos + l.size);
+        armada.inicio[fila + 1] = static_cast<uint32_t>(armada.ids.size());
+    }
+    armada.muerta.assign(armada.ids.size(), false);
+    armada.muertas.assign(filas, 0);
+    lista = move(armada);
+}
+
+void AdyacenciaValoraciones::consolidarSiHaceFalta()
+{
+    size_t cambios = nuevas + quitadas;
+    if (cambios < CAMBIOS_MINIMOS || cambios < porUsuario.ids.size() / 8)
+        return;
+    consolidar(porUsuario, nuevasPorUsuario, true);
+    consolidar(porCancion, nuevasPorCancion, false);
+    nuevasPorUsuario.clear();
+    nuevasPorCancion.clear();
+    nuevas = 0;
+    quitadas = 0;
+    filasBase = filasVistas;
+}
+
+ListaAdyacencia AdyacenciaValoraciones::vista(const ListasCSR &lista, const unordered_map<uint32_t, vector<uint32_t>> &nuevas, bool deUsuario,
+                                              uint32_t fila, CopiaAdyacencia &copia) const
+{
+    ListaAdyacencia base = lista[fila];
+    auto extra = nuevas.find(fila);
+    bool conNuevas = extra != nuevas.end() && !extra->second.empty();
+    if (!conNuevas && (fila >= lista.filas() || lista.muertas[fila] == 0))
+        return base;
+
+    // Las vivas de la lista, ya en orden, y detrás las nuevas; la mezcla es estable, así que
+    // entre elementos del mismo id los más antiguos van primero, como en la lista
+    struct Elemento
+    {
+        uint32_t id;
+        uint16_t medias;
+        uint32_t tiempo;
+    };
+    vector<Elemento> elementos;
+    for (size_t i = 0; i < base.size; i++)
+    {
+        if (!lista.muerta[lista.inicio[fila] + i])
+            elementos.push_back({base.ids[i], base.medias[i], base.tiempos[i]});
+    }
+    size_t vivas = elementos.size();
+    if (conNuevas)
+    {
+        for (uint32_t nueva : extra->second)
+        {
+            const Valoracion &v = (*almacen)[nueva];
+            elementos.push_back({deUsuario ? v.cancion : v.usuario, v.medias, v.tiempo});
+        }
+    }
+    auto porId = [](const Elemento &a, const Elemento &b)
+    { return a.id < b.id; };
+    stable_sort(elementos.begin() + vivas, elementos.end(), porId);
+    inplace_merge(elementos.begin(), elementos.begin() + vivas, elementos.end(), porId);
+
+    copia.ids.resize(elementos.size());
+    copia.medias.resize(elementos.size());
+    copia.tiempos.resize(elementos.size());
+    for (size_t i = 0; i < elementos.size(); i++)
+    {
+        copia.ids[i] = elementos[i].id;
+        copia.medias[i] = elementos[i].medias;
+        copia.tiempos[i] = elementos[i].tiempo;
+    }
+    return {copia.ids.data(), copia.medias.data(), copia.tiempos.data(), copia.ids.size()};
+}
+
+ListaAdyacencia AdyacenciaValoraciones::canciones(uint32_t usuario, CopiaAdyacencia &copia) const
+{
+    return vista(porUsuario, nuevasPorUsuario, true, usuario, copia);
+}
+
+ListaAdyacencia AdyacenciaValoraciones::usuarios(uint32_t cancion, CopiaAdyacencia &copia) const
+{
+    return vista(porCancion, nuevasPorCancion, false, cancion, copia);
+}
@@ -0,0 +1,106 @@
+#ifndef VALORACION_ADYACENCIA_H
+#define VALORACION_ADYACENCIA_H
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "valoracion.h"
+#include "valoracionIndices.h"
+
+using namespace std;
+
+// Las valoraciones de un usuario (o de una canción) como arreglos contiguos: los ids del otro
+// lado, en orden creciente, el valor de cada una en medias estrellas y su tiempo
+struct ListaAdyacencia
+{
+    const uint32_t *ids;
+    const uint16_t *medias;
+    const uint32_t *tiempos;
+    size_t size;
+};
+
+// Dónde se arma una lista que tuvo cambios, para que la ListaAdyacencia pueda apuntar a ella
+struct CopiaAdyacencia
+{
+    vector<uint32_t> ids;
+    vector<uint16_t> medias;
+    vector<uint32_t> tiempos;
+};
+
+// De dónde salen las canciones de un usuario y los usuarios de una canción: de las listas en
+// memoria (AdyacenciaValoraciones) o de un índice paginado (IndicePaginado). La lista devuelta
+// puede apuntar a copia, así que vale mientras copia no cambie.
+class FuenteAdyacencia
+{
+public:
+    virtual ~FuenteAdyacencia() = default;
+    virtual ListaAdyacencia canciones(uint32_t usuario, CopiaAdyacencia &copia) const = 0;
+    virtual ListaAdyacencia usuarios(uint32_t cancion, CopiaAdyacencia &copia) const = 0;
+};
+
+// Listas de adyacencia en formato CSR (compressed sparse row): los elementos de la fila i están
+// en las posiciones [inicio[i], inicio[i + 1]) de ids, medias y tiempos. Los elementos quitados
+// después se marcan en muerta y se cuentan por fila.
+class ListasCSR
+{
+    vector<uint32_t> inicio;
+    vector<uint32_t> ids;
+    vector<uint16_t> medias;
+    vector<uint32_t> tiempos;
+    vector<bool> muerta;
+    vector<uint32_t> muertas;
+
+    friend class AdyacenciaValoraciones;
+
+    bool quitar(uint32_t fila, uint32_t id, uint16_t medias, uint32_t tiempo);
+
+public:
+    uint32_t filas() const { return inicio.empty() ? 0 : static_cast<uint32_t>(inicio.size() - 1); }
+    // Tal como se construyó; vacía si la fila no existe, p. ej. StringDictionary::NONE
+    ListaAdyacencia operator[](uint32_t fila) const;
+};
+
+// Canciones de cada usuario y usuarios de cada canción. Las listas CSR se construyen a partir de
+// las filas vivas del almacén; después sigue al almacén como un índice: las filas quitadas se
+// marcan en las listas y las nuevas se guardan aparte por usuario y por canción. canciones() y
+// usuarios() dan la lista al día, sin copiarla si no tuvo cambios. Cuando las filas nuevas y las
+// quitadas suman un octavo de las listas (y al menos CAMBIOS_MINIMOS), las listas se vuelven a
+// armar con ellas en una pasada lineal, en el mismo paso del almacén que las agregó o quitó, así
+// que armar una lista al consultarla no crece con el tiempo que lleva la ingesta.
+class AdyacenciaValoraciones : public RowStoreListener<Valoracion>, public FuenteAdyacencia
+{
+    AlmacenValoraciones *almacen;
+    uint32_t filasBase;   // las filas anteriores están en las listas CSR
+    uint32_t filasVistas; // filas de las que ya se supo, nuevas o no
+    ListasCSR porUsuario;
+    ListasCSR porCancion;
+    unordered_map<uint32_t, vector<uint32_t>> nuevasPorUsuario; // filas
+    unordered_map<uint32_t, vector<uint32_t>> nuevasPorCancion;
+    size_t nuevas;   // filas vivas fuera de las listas
+    size_t quitadas; // elementos marcados en cada lista
+
+    static const size_t CAMBIOS_MINIMOS = 1 << 16;
+
+    template <typename Recorrido>
+    static void repartir(ListasCSR &lista, uint32_t filas, size_t total, Recorrido recorrer);
+    ListaAdyacencia vista(const ListasCSR &lista, const unordered_map<uint32_t, vector<uint32_t>> &nuevas, bool deUsuario,
+                          uint32_t fila, CopiaAdyacencia &copia) const;
+    void agregar(uint32_t fila);
+    void consolidar(ListasCSR &lista, const unordered_map<uint32_t, vector<uint32_t>> &nuevas, bool deUsuario);
+    void consolidarSiHaceFalta();
+
+public:
+    // usuarios y canciones: cuántos ids hay de cada uno (ver CodigosValoraciones)
+    AdyacenciaValoraciones(AlmacenValoraciones &almacen, uint32_t usuarios, uint32_t canciones);
+    ~AdyacenciaValoraciones();
+    AdyacenciaValoraciones(const AdyacenciaValoraciones &) = delete;
+    AdyacenciaValoraciones &operator=(const AdyacenciaValoraciones &) = delete;
+
+    ListaAdyacencia canciones(uint32_t usuario, CopiaAdyacencia &copia) const override;
+    ListaAdyacencia usuarios(uint32_t cancion, CopiaAdyacencia &copia) const override;
+
+    void row_added(uint32_t fila) override;
+    void rows_added(uint32_t primera, uint32_t ultima) override;
+    void row_removed(uint32_t fila) override;
+};
+
+#endif // VALORACION_ADYACENCIA_H
@@ -0,0 +1,44 @@
+#include "valoracionAgregados.h"
+#include <algorithm>
+#include <numeric>
+
+AgregadosCanciones::AgregadosCanciones(AlmacenValoraciones &_almacen, uint32_t canciones)
+    : almacen(&_almacen), porCancion(canciones)
+{
+    for (uint32_t fila = 0; fila < _almacen.size(); fila++)
+    {
+        if (_almacen.live(fila))
+            sumar(_almacen[fila], 1);
+    }
+    _almacen.listen(this);
+}
+
+AgregadosCanciones::~AgregadosCanciones()
+{
+    almacen->unlisten(this);
+}
+
+void AgregadosCanciones::sumar(const Valoracion &v, int signo)
+{
+    if (v.cancion >= porCancion.size())
+        porCancion.resize(size_t(v.cancion) + 1);
+    Agregado &agregado = porCancion[v.cancion];
+    agregado.cuentas[min<uint16_t>(v.medias, MAX_MEDIAS + 1)] += signo;
+    agregado.sumaMedias += int64_t(signo) * v.medias;
+}
+
+uint32_t AgregadosCanciones::cantidad(uint32_t cancion) const
+{
+    const Agregado &agregado = porCancion[cancion];
+    return accumulate(agregado.cuentas.begin(), agregado.cuentas.end(), 0u);
+}
+
+void AgregadosCanciones::row_added(uint32_t fila)
+{
+    sumar((*almacen)[fila], 1);
+}
+
+void AgregadosCanciones::row_removed(uint32_t fila)
+{
+    sumar((*almacen)[fila], -1);
+}
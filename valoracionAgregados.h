@@ -0,0 +1,48 @@
+#ifndef VALORACION_AGREGADOS_H
+#define VALORACION_AGREGADOS_H
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "valoracion.h"
+#include "valoracionIndices.h"
+
+using namespace std;
+
+// Totales de cada canción, al día con el almacén como un índice: cuántas valoraciones tiene con
+// cada valor de 0 a 5 estrellas, en medias estrellas, y la suma de todos sus valores. De ahí
+// salen la cantidad, la suma y cualquier puntaje que dependa solo del valor de cada valoración,
+// sin recorrer las valoraciones. Los valores de más de 5 estrellas se cuentan juntos.
+class AgregadosCanciones : public RowStoreListener<Valoracion>
+{
+public:
+    static const uint16_t MAX_MEDIAS = 10; // 5 estrellas
+
+    struct Agregado
+    {
+        array<uint32_t, MAX_MEDIAS + 2> cuentas{}; // por medias; la última, las de más de MAX_MEDIAS
+        uint64_t sumaMedias = 0;
+    };
+
+private:
+    AlmacenValoraciones *almacen;
+    vector<Agregado> porCancion;
+
+    void sumar(const Valoracion &v, int signo);
+
+public:
+    // canciones: cuántos ids de canción hay (ver CodigosValoraciones); los nuevos se agregan solos
+    AgregadosCanciones(AlmacenValoraciones &almacen, uint32_t canciones);
+    ~AgregadosCanciones();
+    AgregadosCanciones(const AgregadosCanciones &) = delete;
+    AgregadosCanciones &operator=(const AgregadosCanciones &) = delete;
+
+    uint32_t canciones() const { return static_cast<uint32_t>(porCancion.size()); }
+    const Agregado &operator[](uint32_t cancion) const { return porCancion[cancion]; }
+    uint32_t cantidad(uint32_t cancion) const;
+    float suma(uint32_t cancion) const { return porCancion[cancion].sumaMedias * 0.5f; }
+
+    void row_added(uint32_t fila) override;
+    void row_removed(uint32_t fila) override;
+};
+
+#endif // VALORACION_AGREGADOS_H
@@ -0,0 +1,45 @@
+#ifndef VALORACION_INDICES_H
+#define VALORACION_INDICES_H
+#include <cstdint>
+#include "RowStore.h"
+#include "SecondaryIndex.h"
+#include "valoracion.h"
+
+using namespace std;
+
+// Las valoraciones se guardan una sola vez en el almacén; los índices solo guardan su fila.
+typedef RowStore<Valoracion> AlmacenValoraciones;
+
+// Orden completo de Valoracion (valor, usuario, canción), con sus rangos por valor. Las hojas
+// guardan además los valores en una columna, para filtrar por valor sin leer las valoraciones
+struct ClavePorValor
+{
+    const Valoracion &operator()(const Valoracion &v) const { return v; }
+    static float column(const Valoracion &v) { return v.valor(); }
+};
+
+// Por id de usuario y de canción (ver CodigosValoraciones)
+struct ClavePorUsuario
+{
+    const uint32_t &operator()(const Valoracion &v) const { return v.usuario; }
+};
+
+struct ClavePorCancion
+{
+    const uint32_t &operator()(const Valoracion &v) const { return v.cancion; }
+};
+
+// Por tiempo, para recorrer las valoraciones entre dos instantes; como en ClavePorValor, los
+// valores van en una columna, así que el rango de tiempo se filtra además por valor sin leerlas
+struct ClavePorTiempo
+{
+    const uint32_t &operator()(const Valoracion &v) const { return v.tiempo; }
+    static float column(const Valoracion &v) { return v.valor(); }
+};
+
+typedef SecondaryIndex<AlmacenValoraciones, ClavePorValor> IndicePorValor;
+typedef SecondaryIndex<AlmacenValoraciones, ClavePorUsuario> IndicePorUsuario;
+typedef SecondaryIndex<AlmacenValoraciones, ClavePorCancion> IndicePorCancion;
+typedef SecondaryIndex<AlmacenValoraciones, ClavePorTiempo> IndicePorTiempo;
+
+#endif // VALORACION_INDICES_H